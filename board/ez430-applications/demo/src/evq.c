@@ -0,0 +1,74 @@
+/**
+ *  \file   evq.c
+ *  \brief  interrupt to protothread event queues
+ **/
+
+#if defined(__GNUC__) && defined(__MSP430__)
+/* This is the MSPGCC compiler */
+#include <msp430.h>
+#include <legacymsp430.h>
+#elif defined(__IAR_SYSTEMS_ICC__)
+/* This is the IAR compiler */
+#include <io430.h>
+#endif
+
+#include "evq.h"
+#include "ptsched.h"
+
+#define EVQ_MASK (EVQ_SIZE - 1)
+
+void evq_init(struct evq *q, uint8_t thread)
+{
+	uint8_t prio;
+
+	for (prio = 0; prio < EVQ_NUM_PRIO; prio++) {
+		q->ring[prio].head = 0;
+		q->ring[prio].tail = 0;
+	}
+	q->thread = thread;
+	q->dropped = 0;
+}
+
+int evq_post(struct evq *q, uint8_t prio, uint8_t type, uint8_t arg,
+	     void *ptr)
+{
+	struct evq_ring *r = &q->ring[prio];
+	struct event *ev;
+	unsigned int state;
+	int ret = 0;
+
+	state = __get_interrupt_state();
+	__disable_interrupt();
+	if ((uint8_t) (r->head - r->tail) == EVQ_SIZE) {
+		q->dropped++;
+		ret = -1;
+	} else {
+		ev = &r->ev[r->head & EVQ_MASK];
+		ev->type = type;
+		ev->arg = arg;
+		ev->ptr = ptr;
+		/* publish the event once written */
+		r->head++;
+	}
+	__set_interrupt_state(state);
+
+	sched_wake(q->thread);
+	return ret;
+}
+
+int evq_get(struct evq *q, struct event *ev)
+{
+	struct evq_ring *r;
+	uint8_t prio;
+
+	for (prio = 0; prio < EVQ_NUM_PRIO; prio++) {
+		r = &q->ring[prio];
+		if (r->head != r->tail) {
+			*ev = r->ev[r->tail & EVQ_MASK];
+			/* frees the slot once copied */
+			r->tail++;
+			return 1;
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,62 @@
+/**
+ *  \file   evq.h
+ *  \brief  interrupt to protothread event queues
+ *
+ * A queue holds one ring of events per priority level. Interrupt
+ * handlers post events, a single protothread consumes them, highest
+ * priority ring first. Posting makes the consumer runnable (ptsched.h).
+ *
+ * Each ring has one producer and one consumer: the producer only writes
+ * head, the consumer only writes tail, both are bytes so the consumer
+ * never masks interrupts. Handlers do not nest on the MSP430, so every
+ * interrupt may post to the same ring; evq_post also masks interrupts
+ * itself when called from a thread.
+ *
+ * A post to a full ring fails and is counted in dropped, events already
+ * queued are never overwritten.
+ **/
+
+#ifndef EVQ_H
+#define EVQ_H
+
+#include <stdint.h>
+
+#include "pt.h"
+
+#define EVQ_PRIO_HIGH 0
+#define EVQ_PRIO_LOW  1
+#define EVQ_NUM_PRIO  2
+
+/* events per ring, must be a power of 2 */
+#define EVQ_SIZE 4
+
+struct event {
+	uint8_t type;
+	uint8_t arg;
+	void *ptr;
+};
+
+struct evq_ring {
+	struct event ev[EVQ_SIZE];
+	volatile uint8_t head;	/* written by the producer */
+	volatile uint8_t tail;	/* written by the consumer */
+};
+
+struct evq {
+	struct evq_ring ring[EVQ_NUM_PRIO];
+	uint8_t thread;		/* consumer, woken on post */
+	volatile uint8_t dropped;
+};
+
+void evq_init(struct evq *q, uint8_t thread);
+/* returns non 0 if the prio ring is full, the event is then dropped */
+int evq_post(struct evq *q, uint8_t prio, uint8_t type, uint8_t arg,
+	     void *ptr);
+/* consumer side, copies the oldest event of the highest priority to ev,
+ * returns 0 if all rings are empty */
+int evq_get(struct evq *q, struct event *ev);
+
+/* blocks the calling protothread until an event is read into ev */
+#define PT_WAIT_EVENT(pt, q, ev) PT_WAIT_UNTIL(pt, evq_get(q, ev))
+
+#endif
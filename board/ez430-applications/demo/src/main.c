@@ -31,24 +31,73 @@
 #include "cc2500.h"
 #include "flash.h"
 #include "watchdog.h"
+#include "fmt.h"
 
 #include "pt.h"
+#include "uplink.h"
+#include "params.h"
+#include "prof.h"
+#include "ptsched.h"
+#include "evq.h"
+#include "ptq.h"
+#include "swdog.h"
+#include "report.h"
+#include "power.h"
 
-#define DBG_PRINTF printf
+#define DBG_PRINTF fmt_str
 
+/* profiling probes of the application (make PROFILING=1) */
+#define PROF_THREAD_PROCESS_MSG PROF_FIRST_USER
 
-/* 100 Hz timer A */
+
+/* software timer durations are counted in 10 ms units */
 #define TIMER_PERIOD_MS 10
 
-#define PKTLEN 7
+/* the USCI turns SMCLK back on in LPM3 when a start bit comes in, so
+ * host commands are received from LPM3: LPM0 is only kept while a
+ * transmission is pending, build with UART_LISTEN=1 to always idle in
+ * LPM0 */
+#ifndef UART_LISTEN
+#define UART_LISTEN 0
+#endif
+
+/* temperatures are sampled at each report, or with TEMPERATURE_STREAM=1
+ * converted by the ADC10 on its own every ~5.5 s (adc10.h) and
+ * averaged by batches of TEMPERATURE_BATCH (a power of 2, at most 64) */
+#ifndef TEMPERATURE_STREAM
+#define TEMPERATURE_STREAM 0
+#endif
+#ifndef TEMPERATURE_BATCH
+#define TEMPERATURE_BATCH 4
+#endif
+#if TEMPERATURE_BATCH > 64 || (TEMPERATURE_BATCH & (TEMPERATURE_BATCH - 1))
+#error "TEMPERATURE_BATCH must be a power of 2, at most 64"
+#endif
+
+/* the eZ430-RF2500 USB bridge (application UART) runs at a fixed 9600
+ * bauds, faster rates are only usable from the battery board header */
+#define UART_BAUDRATE 9600
+
+/* readings are sent to the host either as SLIP framed binary
+ * (decoded back to CSV by ezconsole -b) or as CSV text */
+#define UPLINK_CSV 0
+#define UPLINK_BINARY 1
+#ifndef UPLINK_MODE
+#define UPLINK_MODE UPLINK_BINARY
+#endif
+
+#define PKTLEN 8
 #define MAX_HOPS 3
 #define MSG_BYTE_TYPE 0U
 #define MSG_BYTE_HOPS 1U
 #define MSG_BYTE_SRC_ROUTE 2U
 #define MSG_BYTE_CONTENT (MAX_HOPS + 2)
+/* temperature messages: value (2 bytes), battery in 1/10 V */
+#define MSG_BYTE_BATTERY (MSG_BYTE_CONTENT + 2)
 #define MSG_TYPE_ID_REQUEST 0x00
 #define MSG_TYPE_ID_REPLY 0x01
 #define MSG_TYPE_TEMPERATURE 0x02
+#define MSG_TYPE_REPORT_POLICY 0x03 /* max silence in seconds */
 
 #define NODE_ID_LOCATION INFOD_START
 
@@ -59,60 +108,95 @@
 #define ID_INPUT_TIMEOUT_TICKS (ID_INPUT_TIMEOUT_SECONDS*1000/TIMER_PERIOD_MS)
 static unsigned char node_id;
 
-#define NUM_TIMERS 6
-static uint16_t timer[NUM_TIMERS];
-#define TIMER_LED_RED_ON timer[0]
-#define TIMER_LED_GREEN_ON timer[1]
-#define TIMER_ANTIBOUNCING timer[2]
-#define TIMER_RADIO_SEND timer[3]
-#define TIMER_ID_INPUT timer[4]
-#define TIMER_RADIO_FORWARD timer[5]
+/* temperatures are only sent on changes, see report.h */
+static struct report temperature_report;
+/* the sink is told the policy before the next reading */
+static int report_policy_changed;
+
+/* Protothreads run by ptsched.c, see ptsched.h for the fields, a run takes
+ * a few ms at most: deadlines only catch hangs. The red led toggles every
+ * 1000 ms as it always did: 100 timer counts of TIMER_PERIOD_MS */
+
+#define APP_TASKS(TASK) \
+    TASK(LED_RED,       thread_led_red,       0, 1000, 3, 1000) \
+    TASK(LED_GREEN,     thread_led_green,     0,    0, 3, 1000) \
+    TASK(ANTIBOUNCING,  thread_antibouncing,  0,    0, 2, 1000) \
+    TASK(PROCESS_MSG,   thread_process_msg,   1,    0, 0, 1000) \
+    TASK(PERIODIC_SEND, thread_periodic_send, 1,    0, 1, 1000) \
+    TASK(BUTTON,        thread_button,        0,    0, 2, 1000)
+
+SCHED_TASK_IDS(APP_TASKS);
+
+/* Events posted by the interrupt handlers */
+
+#define EVENT_RADIO_RX   1 /* high priority, packet in radio_rx_queue */
+#define EVENT_UART_FRAME 2 /* low priority                            */
+#define EVENT_BUTTON     3 /* low priority                            */
+
+/* consumed by thread_process_msg */
+static struct evq msg_events;
+/* consumed by thread_button */
+static struct evq button_events;
+
+#define NUM_TIMERS 5
+static struct timer_event timer[NUM_TIMERS];
+#define TIMER_LED_GREEN_ON (&timer[0])
+#define TIMER_ANTIBOUNCING (&timer[1])
+#define TIMER_RADIO_SEND (&timer[2])
+#define TIMER_ID_INPUT (&timer[3])
+#define TIMER_RADIO_FORWARD (&timer[4])
 
 static void printhex(char *buffer, unsigned int len)
 {
     unsigned int i;
     for(i = 0; i < len; i++)
     {
-        printf("%02X ", buffer[i]);
+        fmt_u8_hex(buffer[i]);
+        putchar(' ');
     }
 }
 
 static void dump_message(char *buffer)
 {
-    printf("message received\r\n  content: ");
+    fmt_str("message received\r\n  content: ");
     printhex(buffer, PKTLEN);
-    printf("\r\n  type: ");
+    fmt_str("\r\n  type: ");
     switch(buffer[MSG_BYTE_TYPE])
     {
         case MSG_TYPE_ID_REQUEST:
-            printf("id request");
+            fmt_str("id request");
             break;
         case MSG_TYPE_ID_REPLY:
-            printf("id reply");
+            fmt_str("id reply");
             break;
         case MSG_TYPE_TEMPERATURE:
-            printf("temperature");
+            fmt_str("temperature");
+            break;
+        case MSG_TYPE_REPORT_POLICY:
+            fmt_str("report policy");
             break;
     }
-    printf("\r\n  num hops: %d\r\n", buffer[MSG_BYTE_HOPS]);
-    printf("  route: ");
+    fmt_str("\r\n  num hops: ");
+    fmt_i16_dec(buffer[MSG_BYTE_HOPS]);
+    fmt_str("\r\n  route: ");
     unsigned int i;
     for(i = MSG_BYTE_SRC_ROUTE; i < MSG_BYTE_SRC_ROUTE + buffer[MSG_BYTE_HOPS]; i++)
     {
         if(buffer[i] == 0x00)
         {
-            printf("undefined");
+            fmt_str("undefined");
         }
         else
         {
-            printf("%02X", buffer[i]);
+            fmt_u8_hex(buffer[i]);
         }
         if(i < MSG_BYTE_SRC_ROUTE + buffer[MSG_BYTE_HOPS])
         {
-            printf("->");
+            fmt_str("->");
         }
     }
-    printf("%02X\r\n", node_id);
+    fmt_u8_hex(node_id);
+    fmt_eol();
 
     if(buffer[MSG_BYTE_TYPE] == MSG_TYPE_TEMPERATURE)
     {
@@ -120,51 +204,136 @@ static void dump_message(char *buffer)
         char *pt = (char *) &temperature;
         pt[0] = buffer[MSG_BYTE_CONTENT + 1];
         pt[1] = buffer[MSG_BYTE_CONTENT];
-        printf("  temperature: %d\r\n", temperature);
+        fmt_str("  temperature: ");
+        fmt_i16_dec(temperature);
+        fmt_eol();
     }
 
 }
 
+#if UPLINK_MODE == UPLINK_CSV
+/* node_id,<id>,temperature,<t>,rssi,<rssi>,help,<hops>,battery,<v> */
+static void print_csv_temperature(uint8_t id, int16_t temperature, int8_t rssi, uint8_t hops, uint8_t battery)
+{
+    fmt_str("node_id,");
+    fmt_u16_dec(id);
+    fmt_str(",temperature,");
+    fmt_decicelsius(temperature);
+    fmt_str(",rssi,");
+    fmt_i16_dec(rssi);
+    fmt_str(",help,");
+    fmt_u16_dec(hops);
+    fmt_str(",battery,");
+    fmt_u16_dec(battery / 10);
+    putchar('.');
+    fmt_u16_dec(battery % 10);
+    fmt_eol();
+}
+
+/* policy,node_id,<id>,max_silence,<seconds> */
+static void print_csv_report_policy(uint8_t id, uint16_t max_silence)
+{
+    fmt_str("policy,node_id,");
+    fmt_u16_dec(id);
+    fmt_str(",max_silence,");
+    fmt_u16_dec(max_silence);
+    fmt_eol();
+}
+#endif
+
+/* the host answers with a framed command, typed bytes are not ids */
 static void prompt_node_id()
 {
-    printf("A node requested an id. You have %d seconds to enter an 8-bit ID.\r\n", ID_INPUT_TIMEOUT_SECONDS);
+    fmt_str("A node requested an id, send \"set node_id <id>\".\r\n");
 }
 
 /* returns 1 if the id was expected and set, 0 otherwise */
 static void set_node_id(unsigned char id)
 {
-    TIMER_ID_INPUT = UINT_MAX;
+    timer_event_stop(TIMER_ID_INPUT);
     if(flash_write_byte((unsigned char *) NODE_ID_LOCATION, id) != 0)
     {
         flash_erase_segment((unsigned int *) NODE_ID_LOCATION);
         flash_write_byte((unsigned char *) NODE_ID_LOCATION, id);
     }
     node_id = id;
-    printf("this node id is now 0x%02X\r\n", id);
+    /* a new node for the sink */
+    report_policy_changed = 1;
+    report_force(&temperature_report);
+    sched_wake(THREAD_PERIODIC_SEND);
+#if UPLINK_MODE == UPLINK_CSV
+    fmt_str("this node id is now 0x");
+    fmt_u8_hex(id);
+    fmt_eol();
+#endif
 }
 
-/* Protothread contexts */
-
-#define NUM_PT 7
-static struct pt pt[NUM_PT];
-
 
 /*
  * Timer
  */
 
-void timer_tick_cb() {
-    int i;
-    for(i = 0; i < NUM_TIMERS; i++)
+/* thread waiting for each timer */
+static const uint8_t timer_thread[NUM_TIMERS] = {
+    THREAD_LED_GREEN, THREAD_ANTIBOUNCING, THREAD_PERIODIC_SEND,
+    THREAD_PROCESS_MSG, THREAD_PROCESS_MSG
+};
+
+static int timer_wake_cb(struct timer_event *ev)
+{
+    sched_wake(timer_thread[ev - timer]);
+    return 1;
+}
+
+/* one-shot, count in TIMER_PERIOD_MS units, safe from interrupts */
+static void timer_restart(struct timer_event *timer, uint16_t count)
+{
+    timer_event_start(timer,
+      timer_ms_to_ticks((uint32_t) count * TIMER_PERIOD_MS), 0,
+      timer_wake_cb);
+}
+
+/* a stopped or never started timer is reached */
+static int timer_reached(struct timer_event *timer)
+{
+    return !timer_event_pending(timer);
+}
+
+/* uplink timestamp, in UPLINK_TIMESTAMP_MS units */
+static uint16_t uptime(void)
+{
+    return clock_now_ms() / UPLINK_TIMESTAMP_MS;
+}
+
+/* task id of the last hang, and hang count in the high byte, 0xFFFF for
+ * none */
+static uint16_t hang_value()
+{
+    uint8_t task, count;
+    if(!swdog_last_hang(&task, &count))
     {
-        if(timer[i] != UINT_MAX) {
-            timer[i]++;
-        }
+        return 0xFFFF;
     }
+    return task | (count << 8);
 }
 
-int timer_reached(uint16_t timer, uint16_t count) {
-    return (timer >= count);
+/* tells the host why the previous run ended, if a task hung */
+static void report_hang()
+{
+    uint16_t value = hang_value();
+    if(value == 0xFFFF)
+    {
+        return;
+    }
+#if UPLINK_MODE == UPLINK_BINARY
+    uplink_send_param(uptime(), PARAM_HANG, UPLINK_STATUS_OK, value);
+#else
+    fmt_str("hang,task,");
+    fmt_u16_dec(value & 0xFF);
+    fmt_str(",count,");
+    fmt_u16_dec(value >> 8);
+    fmt_eol();
+#endif
 }
 
 
@@ -180,6 +349,7 @@ static void led_green_blink(int duration)
 {
     led_green_duration = duration;
     led_green_flag = 1;
+    sched_wake(THREAD_LED_GREEN);
 }
 
 static PT_THREAD(thread_led_green(struct pt *pt))
@@ -190,9 +360,8 @@ static PT_THREAD(thread_led_green(struct pt *pt))
     {
         PT_WAIT_UNTIL(pt, led_green_flag);
         led_green_on();
-        TIMER_LED_GREEN_ON = 0;
-        PT_WAIT_UNTIL(pt, timer_reached(TIMER_LED_GREEN_ON,
-          led_green_duration));
+        timer_restart(TIMER_LED_GREEN_ON, led_green_duration);
+        PT_WAIT_UNTIL(pt, timer_reached(TIMER_LED_GREEN_ON));
         led_green_off();
         led_green_flag = 0;
     }
@@ -207,8 +376,7 @@ static PT_THREAD(thread_led_red(struct pt *pt))
     while(1)
     {
         led_red_switch();
-        TIMER_LED_RED_ON = 0;
-        PT_WAIT_UNTIL(pt, timer_reached(TIMER_LED_RED_ON, 100));
+        PT_WAIT_NEXT_PERIOD(pt);
     }
 
     PT_END(pt);
@@ -221,9 +389,22 @@ static PT_THREAD(thread_led_red(struct pt *pt))
 
 static char radio_tx_buffer[PKTLEN];
 static char radio_rx_buffer[PKTLEN];
-static int radio_rx_flag;
+/* written by the CC2500 driver on reception, radio_cb queues a copy:
+ * the threads keep radio_tx_buffer and radio_rx_buffer to themselves */
+static uint8_t radio_rx_isr_buffer[PKTLEN];
 int8_t last_rssi;
 
+/* received packets, buffered until thread_process_msg reads them */
+struct radio_packet
+{
+    char data[PKTLEN];
+    int8_t rssi;
+};
+
+#define RADIO_RX_QUEUE 4
+static struct radio_packet radio_rx_storage[RADIO_RX_QUEUE];
+static struct pt_queue radio_rx_queue;
+
 void radio_cb(uint8_t *buffer, int size, int8_t rssi)
 {
     //led_green_blink(10); /* 10 timer ticks = 100 ms */
@@ -252,15 +433,22 @@ void radio_cb(uint8_t *buffer, int size, int8_t rssi)
                 /* post event to application */
                 //DBG_PRINTF("rssi %d\r\n", rssi);
 
-                memcpy(radio_rx_buffer, buffer, PKTLEN);
-                //FIXME what if radio_rx_flag == 1 already?
-		last_rssi = rssi;
-                radio_rx_flag = 1;
+                struct radio_packet packet;
+                memcpy(packet.data, buffer, PKTLEN);
+                packet.rssi = rssi;
+                /* a full queue counts the drop, read by get rx_dropped */
+                if(pt_queue_put_isr(&radio_rx_queue, &packet) == 0)
+                {
+                    evq_post(&msg_events, EVQ_PRIO_HIGH, EVENT_RADIO_RX, 0,
+                      NULL);
+                }
             }
             else
             {
                 /* packet error, drop */
-                DBG_PRINTF("msg packet error size=%d\r\n",size);
+                DBG_PRINTF("msg packet error size=");
+                fmt_i16_dec(size);
+                fmt_eol();
             }
             break;
     }
@@ -275,13 +463,76 @@ static void radio_send_message()
     cc2500_rx_enter();
 }
 
+
+/*
+ * Runtime parameters
+ */
+
+/* timer ticks between two readings */
+static uint16_t report_interval;
+
+/* pushes the parameters to the code and hardware using them */
+static void params_apply()
+{
+    uint16_t value;
+    uint16_t deadband, heartbeat;
+
+    params_get(PARAM_REPORT_INTERVAL, &report_interval);
+    params_get(PARAM_DEADBAND, &deadband);
+    params_get(PARAM_HEARTBEAT, &heartbeat);
+    report_init(&temperature_report, deadband, heartbeat);
+    report_policy_changed = 1;
+
+    cc2500_idle();
+    params_get(PARAM_RADIO_CHANNEL, &value);
+    cc2500_set_channel(value);
+    params_get(PARAM_TX_POWER, &value);
+    cc2500_set_power(power_patable(value));
+    cc2500_rx_enter();
+}
+
+static void process_uart_frame();
+
+/* radio packets and host commands, radio first */
 static PT_THREAD(thread_process_msg(struct pt *pt))
 {
+    static struct event event;
+    static struct radio_packet packet;
+
     PT_BEGIN(pt);
 
     while(1)
     {
-        PT_WAIT_UNTIL(pt, radio_rx_flag == 1);
+        PT_WAIT_EVENT(pt, &msg_events, &event);
+        if(event.type == EVENT_UART_FRAME)
+        {
+            /* one frame at a time so that radio events come first, one
+             * event may stand for several frames (see uart_notify) */
+            if(uart_rx_frames() > 0)
+            {
+                process_uart_frame();
+            }
+            if(uart_rx_frames() > 0)
+            {
+                evq_post(&msg_events, EVQ_PRIO_LOW, EVENT_UART_FRAME, 0, NULL);
+            }
+            continue;
+        }
+        /* as for uart frames, one packet per event and a failed post
+         * leaves an earlier event queued */
+        if(event.type != EVENT_RADIO_RX
+          || !pt_queue_try_get(&radio_rx_queue, &packet))
+        {
+            continue;
+        }
+        if(pt_queue_count(&radio_rx_queue) > 0)
+        {
+            evq_post(&msg_events, EVQ_PRIO_HIGH, EVENT_RADIO_RX, 0, NULL);
+        }
+        PROF_BEGIN(PROF_THREAD_PROCESS_MSG);
+
+        memcpy(radio_rx_buffer, packet.data, PKTLEN);
+        last_rssi = packet.rssi;
 
         //dump_message(radio_rx_buffer);
 
@@ -290,7 +541,7 @@ static PT_THREAD(thread_process_msg(struct pt *pt))
             prompt_node_id();
         }
         else if(radio_rx_buffer[MSG_BYTE_TYPE] == MSG_TYPE_ID_REPLY &&
-            !timer_reached(TIMER_ID_INPUT, ID_INPUT_TIMEOUT_TICKS))
+            !timer_reached(TIMER_ID_INPUT))
         {
             set_node_id(radio_rx_buffer[MSG_BYTE_CONTENT]);
         }
@@ -318,8 +569,8 @@ static PT_THREAD(thread_process_msg(struct pt *pt))
                  * (a packet send takes about 30 ms to complete, therefore
                  * we wait 40 ms * node_id before forwarding a packet
                  * to avoid collisions) 
-                TIMER_RADIO_FORWARD = 0;
-                PT_WAIT_UNTIL(pt, timer_reached(TIMER_RADIO_FORWARD, 4 * node_id));
+                timer_restart(TIMER_RADIO_FORWARD, 4 * node_id);
+                PT_WAIT_UNTIL(pt, timer_reached(TIMER_RADIO_FORWARD));
 
                 radio_send_message();
             }
@@ -331,10 +582,24 @@ static PT_THREAD(thread_process_msg(struct pt *pt))
 		pt[0] = radio_rx_buffer[MSG_BYTE_CONTENT + 1];
 		pt[1] = radio_rx_buffer[MSG_BYTE_CONTENT];
 
-
-		printf("node_id,%d,temperature,%d.%d,rssi,%d,help,%d\r\n", (unsigned char) radio_rx_buffer[MSG_BYTE_SRC_ROUTE], temperature / 10, temperature % 10, last_rssi, radio_rx_buffer[MSG_BYTE_HOPS]);
+#if UPLINK_MODE == UPLINK_BINARY
+		uplink_send_temperature(uptime(), radio_rx_buffer[MSG_BYTE_SRC_ROUTE], temperature, last_rssi, radio_rx_buffer[MSG_BYTE_HOPS], radio_rx_buffer[MSG_BYTE_BATTERY]);
+#else
+		print_csv_temperature(radio_rx_buffer[MSG_BYTE_SRC_ROUTE], temperature, last_rssi, radio_rx_buffer[MSG_BYTE_HOPS], radio_rx_buffer[MSG_BYTE_BATTERY]);
+#endif
     	}
-        radio_rx_flag = 0;
+	else if(radio_rx_buffer[MSG_BYTE_TYPE] == MSG_TYPE_REPORT_POLICY)
+	{
+		uint16_t max_silence = (radio_rx_buffer[MSG_BYTE_CONTENT] << 8)
+		    | (uint8_t) radio_rx_buffer[MSG_BYTE_CONTENT + 1];
+
+#if UPLINK_MODE == UPLINK_BINARY
+		uplink_send_report_policy(uptime(), radio_rx_buffer[MSG_BYTE_SRC_ROUTE], max_silence);
+#else
+		print_csv_report_policy(radio_rx_buffer[MSG_BYTE_SRC_ROUTE], max_silence);
+#endif
+	}
+        PROF_END(PROF_THREAD_PROCESS_MSG);
     }
 
     PT_END(pt);
@@ -345,15 +610,8 @@ static PT_THREAD(thread_process_msg(struct pt *pt))
  * UART
  */
 
-static int uart_flag;
-static uint8_t uart_data;
-
-int uart_cb(uint8_t data)
-{
-    uart_flag = 1;
-    uart_data = data;
-    return 0;
-}
+/* SLIP escaping at most doubles a frame */
+static uint8_t uart_frame[2 * UPLINK_FRAME_MAX];
 
 /* to be called from within a protothread */
 static void init_message()
@@ -367,12 +625,68 @@ static void init_message()
     radio_tx_buffer[MSG_BYTE_SRC_ROUTE] = node_id;
 }
 
+#if TEMPERATURE_STREAM
+static uint16_t temperature_ring[2 * TEMPERATURE_BATCH];
+static volatile int stream_temperature;
+
+/* from the ADC10 interrupt, the value waits for the next report */
+static int temperature_batch_cb(const uint16_t *block, uint8_t n)
+{
+    uint16_t sum = 0;
+    uint8_t i;
+    for(i = 0; i < n; i++)
+    {
+        sum += block[i];
+    }
+    stream_temperature = adc10_temp_decicelsius(sum, n);
+    return 0;
+}
+
+static void temperature_start()
+{
+    /* until the first batch */
+    stream_temperature = adc10_sample_temp();
+    adc10_stream_start(INCH_10, temperature_ring, TEMPERATURE_BATCH,
+      temperature_batch_cb);
+}
+
+static int read_temperature()
+{
+    return stream_temperature;
+}
+
+/* single conversions and the stream do not mix, the current batch is
+ * lost */
+static int read_avcc()
+{
+    int avcc;
+    adc10_stream_stop();
+    avcc = adc10_sample_avcc();
+    adc10_stream_start(INCH_10, temperature_ring, TEMPERATURE_BATCH,
+      temperature_batch_cb);
+    return avcc;
+}
+#else
+static void temperature_start()
+{
+}
+
+static int read_temperature()
+{
+    return adc10_sample_temp();
+}
+
+static int read_avcc()
+{
+    return adc10_sample_avcc();
+}
+#endif
+
 /* to be called from within a protothread */
-static void send_temperature()
+static void send_temperature(int temperature)
 {
     init_message();
     radio_tx_buffer[MSG_BYTE_TYPE] = MSG_TYPE_TEMPERATURE;
-    int temperature = adc10_sample_temp();
     /*printf("temperature: %d, hex: ", temperature);
     printhex((char *) &temperature, 2);
     putchar('\r');
@@ -381,8 +695,38 @@ static void send_temperature()
     char *pt = (char *) &temperature;
     radio_tx_buffer[MSG_BYTE_CONTENT] = pt[1];
     radio_tx_buffer[MSG_BYTE_CONTENT + 1] = pt[0];
-    printf("node_id,%d,temperature,%d.%d,rssi,%d,help,%d\r\n", node_id, temperature / 10, temperature % 10, 0, 0);
-    //radio_send_message();
+    radio_tx_buffer[MSG_BYTE_BATTERY] = power_avcc();
+#if UPLINK_MODE == UPLINK_BINARY
+    uplink_send_temperature(uptime(), node_id, temperature, 0, 0, power_avcc());
+#else
+    print_csv_temperature(node_id, temperature, 0, 0, power_avcc());
+#endif
+    radio_send_message();
+}
+
+/* the longest silence between two readings, in seconds rounded up */
+static uint16_t report_max_silence()
+{
+    uint32_t ms = (uint32_t) temperature_report.heartbeat
+        * power_interval(report_interval) * TIMER_PERIOD_MS;
+    ms = (ms + 999) / 1000;
+    return ms > 0xFFFF ? 0xFFFF : ms;
+}
+
+/* to be called from within a protothread */
+static void send_report_policy()
+{
+    uint16_t max_silence = report_max_silence();
+    init_message();
+    radio_tx_buffer[MSG_BYTE_TYPE] = MSG_TYPE_REPORT_POLICY;
+    radio_tx_buffer[MSG_BYTE_CONTENT] = max_silence >> 8;
+    radio_tx_buffer[MSG_BYTE_CONTENT + 1] = max_silence & 0xFF;
+#if UPLINK_MODE == UPLINK_BINARY
+    uplink_send_report_policy(uptime(), node_id, max_silence);
+#else
+    print_csv_report_policy(node_id, max_silence);
+#endif
+    radio_send_message();
 }
 
 static void send_id_request()
@@ -393,39 +737,171 @@ static void send_id_request()
 }
 
 
-static void send_id_reply(unsigned char id)
+#if defined(PROFILING)
+/* replies to a prof command, clears the probes if reset is not 0 */
+static void send_prof(uint16_t reset)
 {
-    init_message();
-    radio_tx_buffer[MSG_BYTE_TYPE] = MSG_TYPE_ID_REPLY;
-    radio_tx_buffer[MSG_BYTE_CONTENT] = id;
-    radio_send_message();
-    printf("ID 0x%02X sent\r\n", id);
+#if UPLINK_MODE == UPLINK_BINARY
+    uint16_t smclk_khz = get_smclk_freq_hz() / 1000;
+    uint8_t i;
+    for(i = 0; i < PROF_MAX_PROBES; i++)
+    {
+        if(prof_table[i].count != 0)
+        {
+            uplink_send_prof(uptime(), i, smclk_khz, prof_table[i].count,
+              prof_table[i].min, prof_table[i].max, prof_table[i].total);
+        }
+    }
+#else
+    prof_dump();
+#endif
+    if(reset)
+    {
+        prof_reset();
+    }
 }
 
-static PT_THREAD(thread_uart(struct pt *pt))
+/* replies to a sched command, clears the statistics if reset is not 0 */
+static void send_sched(uint16_t reset)
 {
-    PT_BEGIN(pt);
+#if UPLINK_MODE == UPLINK_BINARY
+    uint16_t smclk_khz = get_smclk_freq_hz() / 1000;
+    struct sched_stats stats;
+    uint8_t i;
+    for(i = 0; i < sched_num_tasks; i++)
+    {
+        sched_stats_get(i, &stats);
+        if(stats.runs != 0)
+        {
+            uplink_send_sched(uptime(), i, smclk_khz, stats.runs, stats.max,
+              stats.total);
+            uplink_send_sched_lat(uptime(), i, stats.lat);
+        }
+    }
+#else
+    sched_dump();
+#endif
+    if(reset)
+    {
+        sched_stats_reset();
+    }
+}
+#endif
 
-    while(1)
+/* from the rx interrupt, once per frame: a post failing on a full ring
+ * leaves an earlier EVENT_UART_FRAME queued, which reads every frame */
+static void uart_notify(void)
+{
+    evq_post(&msg_events, EVQ_PRIO_LOW, EVENT_UART_FRAME, 0, NULL);
+}
+
+static unsigned int smclk_busy(void)
+{
+    return UART_LISTEN || uart_tx_pending();
+}
+
+/* replies to the command frame waiting in the uart rx ring */
+static void process_uart_frame()
+{
+    int len;
+    uint8_t param;
+    uint16_t value;
+    int status;
+
+    len = uart_rx_get_frame(uart_frame, sizeof(uart_frame));
+    len = uplink_unslip(uart_frame, len);
+    if(len < UPLINK_HEADER_LEN + UPLINK_CMD_LEN)
     {
-        PT_WAIT_UNTIL(pt, uart_flag);
+        /* empty frames between two END delimiters, or corrupted */
+        return;
+    }
+
+    led_green_blink(10); /* 10 timer ticks = 100 ms */
 
-        led_green_blink(10); /* 10 timer ticks = 100 ms */
+    param = uart_frame[UPLINK_HEADER_LEN + UPLINK_CMD_PARAM];
+    value = uart_frame[UPLINK_HEADER_LEN + UPLINK_CMD_VALUE]
+        | (uart_frame[UPLINK_HEADER_LEN + UPLINK_CMD_VALUE + 1] << 8);
 
-        /* does the local node expects an id
-         * or do we have to broadcast it? */
-        if(timer_reached(TIMER_ID_INPUT, ID_INPUT_TIMEOUT_TICKS))
+    if(uart_frame[0] == UPLINK_TYPE_CMD_SET)
+    {
+        if(param == PARAM_HANG)
+        {
+            /* read only, but may be cleared once diagnosed */
+            status = UPLINK_STATUS_INVALID;
+            if(value == 0)
+            {
+                swdog_clear();
+                status = UPLINK_STATUS_OK;
+            }
+        }
+        else if(param == PARAM_RX_DROPPED)
         {
-            send_id_reply(uart_data);
+            status = UPLINK_STATUS_INVALID;
+            if(value == 0)
+            {
+                radio_rx_queue.dropped = 0;
+                status = UPLINK_STATUS_OK;
+            }
+        }
+        else if(param == PARAM_NODE_ID)
+        {
+            /* the node id keeps its own flash location */
+            status = UPLINK_STATUS_OK;
+            if(value > 0xFF)
+            {
+                status = UPLINK_STATUS_INVALID;
+            }
+            else
+            {
+                set_node_id(value);
+            }
         }
         else
         {
-            set_node_id(uart_data);
+            status = params_set(param, value);
+            if(status != UPLINK_STATUS_UNKNOWN)
+            {
+                params_apply();
+            }
+        }
+    }
+    else if(uart_frame[0] == UPLINK_TYPE_CMD_GET)
+    {
+        status = UPLINK_STATUS_OK;
+    }
+    else
+    {
+#if defined(PROFILING)
+        if(uart_frame[0] == UPLINK_TYPE_CMD_PROF)
+        {
+            send_prof(value);
+        }
+        else if(uart_frame[0] == UPLINK_TYPE_CMD_SCHED)
+        {
+            send_sched(value);
         }
-        uart_flag = 0;
+#endif
+        return;
     }
 
-    PT_END(pt);
+    if(param == PARAM_NODE_ID)
+    {
+        value = node_id;
+    }
+    else if(param == PARAM_HANG)
+    {
+        value = hang_value();
+    }
+    else if(param == PARAM_RX_DROPPED)
+    {
+        value = radio_rx_queue.dropped;
+    }
+    else if(params_get(param, &value) != UPLINK_STATUS_OK)
+    {
+        status = UPLINK_STATUS_UNKNOWN;
+        value = 0;
+    }
+    uplink_send_param(uptime(), param, status, value);
 }
 
 /*
@@ -434,34 +910,33 @@ static PT_THREAD(thread_uart(struct pt *pt))
 
 #define ANTIBOUNCING_DURATION 10 /* 10 timer counts = 100 ms */
 static int antibouncing_flag;
-static int button_pressed_flag;
 
 void button_pressed_cb()
 {
     if(antibouncing_flag == 0)
     {
-        button_pressed_flag = 1;
         antibouncing_flag = 1;
-        TIMER_ANTIBOUNCING = 0;
+        evq_post(&button_events, EVQ_PRIO_LOW, EVENT_BUTTON, 0, NULL);
+        timer_restart(TIMER_ANTIBOUNCING, ANTIBOUNCING_DURATION);
         led_green_blink(200); /* 200 timer ticks = 2 seconds */
     }
 }
 
 static PT_THREAD(thread_button(struct pt *pt))
 {
+    static struct event event;
+
     PT_BEGIN(pt);
 
     while(1)
     {
-        PT_WAIT_UNTIL(pt, button_pressed_flag == 1);
+        PT_WAIT_EVENT(pt, &button_events, &event);
 
-        TIMER_ID_INPUT = 0;
+        timer_restart(TIMER_ID_INPUT, ID_INPUT_TIMEOUT_TICKS);
 
         /* ask locally for a node id and broadcast an id request */
         prompt_node_id();
         send_id_request();
-
-        button_pressed_flag = 0;
     }
 
 
@@ -475,28 +950,77 @@ static PT_THREAD(thread_antibouncing(struct pt *pt))
     while(1)
     {
         PT_WAIT_UNTIL(pt, antibouncing_flag
-          && timer_reached(TIMER_ANTIBOUNCING, ANTIBOUNCING_DURATION));
+          && timer_reached(TIMER_ANTIBOUNCING));
         antibouncing_flag = 0;
     }
 
     PT_END(pt);
 }
 
+/* VLO drifts with temperature, measure it again every few reports */
+#define VLO_CALIBRATION_REPORTS 32
+static uint8_t vlo_calibration_count;
+
+/* the battery drains slowly, AVcc is sampled every few reports */
+#define POWER_CHECK_REPORTS 16
+static uint8_t power_check_count;
+
+/* samples AVcc, a new power level changes the rate, the tx power and
+ * the policy announced to the sink */
+static void power_check()
+{
+    uint16_t value;
+    if(!power_update(read_avcc()))
+    {
+        return;
+    }
+    cc2500_idle();
+    params_get(PARAM_TX_POWER, &value);
+    cc2500_set_power(power_patable(value));
+    cc2500_rx_enter();
+    report_policy_changed = 1;
+}
+
+/* samples at every report interval, sends on changes only */
 static PT_THREAD(thread_periodic_send(struct pt *pt))
 {
+    int temperature;
+
     PT_BEGIN(pt);
 
     while(1)
     {
-        TIMER_RADIO_SEND = 0;
-        PT_WAIT_UNTIL(pt, node_id != NODE_ID_UNDEFINED && timer_reached( TIMER_RADIO_SEND, 200));
-        send_temperature();
+        timer_restart(TIMER_RADIO_SEND, power_interval(report_interval));
+        PT_WAIT_UNTIL(pt, node_id != NODE_ID_UNDEFINED && timer_reached(TIMER_RADIO_SEND));
+        if(++power_check_count == POWER_CHECK_REPORTS)
+        {
+            power_check_count = 0;
+            power_check();
+        }
+        if(report_policy_changed)
+        {
+            report_policy_changed = 0;
+            send_report_policy();
+        }
+        temperature = read_temperature();
+        if(report_sample(&temperature_report, temperature))
+        {
+            send_temperature(temperature);
+        }
+        if(++vlo_calibration_count == VLO_CALIBRATION_REPORTS)
+        {
+            vlo_calibration_count = 0;
+            clock_calibrate_vlo();
+        }
     }
 
     PT_END(pt);
 }
 
 
+SCHED_TASK_TABLE(APP_TASKS);
+
+
 /*
  * main
  */
@@ -505,18 +1029,14 @@ int main(void)
 {
     watchdog_stop();
 
-    TIMER_ID_INPUT = UINT_MAX;
     node_id = NODE_ID_UNDEFINED;
 
-    /* protothreads init */
-    int i;
-    for(i = 0; i < NUM_PT; i++)
-    {
-        PT_INIT(&pt[i]);
-    }
-
     /* clock init */
     set_mcu_speed_dco_mclk_16MHz_smclk_8MHz();
+    clock_calibrate_vlo();
+#if defined(PROFILING)
+    prof_init();
+#endif
 
     /* LEDs init */
     leds_init();
@@ -524,32 +1044,37 @@ int main(void)
     led_green_flag = 0;
 
     /* timer init */
-    timerA_init();
-    timerA_register_cb(&timer_tick_cb);
-    timerA_start_milliseconds(TIMER_PERIOD_MS);
+    timer_service_init();
 
     /* button init */
     button_init();
     button_register_cb(button_pressed_cb);
     antibouncing_flag = 0;
-    button_pressed_flag = 0;
+    evq_init(&button_events, THREAD_BUTTON);
 
     /* UART init (serial link) */
-    uart_init(UART_9600_SMCLK_8MHZ);
-    uart_register_cb(uart_cb);
-    uart_flag = 0;
-    uart_data = 0;
-
-    /* ADC10 init (temperature) */
+    evq_init(&msg_events, THREAD_PROCESS_MSG);
+    pt_queue_init(&radio_rx_queue, radio_rx_storage,
+      sizeof(struct radio_packet), RADIO_RX_QUEUE, PT_QUEUE_NO_THREAD,
+      PT_QUEUE_NO_THREAD);
+    uart_init_baudrate(UART_BAUDRATE);
+    uart_rx_start(UPLINK_SLIP_END);
+    uart_rx_register_notify(uart_notify);
+    /* sleeping must not stop SMCLK under a transmission */
+    clock_register_smclk_busy_cb(smclk_busy);
+
+    /* ADC10 init (temperature, battery) */
     adc10_start();
+    temperature_start();
+    power_update(read_avcc());
 
     /* radio init */
     spi_init();
     cc2500_init();
-    cc2500_rx_register_buffer(radio_tx_buffer, PKTLEN);
+    cc2500_rx_register_buffer(radio_rx_isr_buffer, PKTLEN);
     cc2500_rx_register_cb(radio_cb);
-    cc2500_rx_enter();
-    radio_rx_flag = 0;
+    params_load();
+    params_apply();
 
     /* retrieve node id from flash */
     node_id = *((char *) NODE_ID_LOCATION);
@@ -558,14 +1083,10 @@ int main(void)
     button_enable_interrupt();
     __enable_interrupt();
 
-    /* simple cycle scheduling */
-    while(1) {
-        /*thread_led_red(&pt[0]);
-        thread_led_green(&pt[1]);
-        thread_uart(&pt[2]);
-        thread_antibouncing(&pt[3]);*/
-        thread_process_msg(&pt[4]);
-        thread_periodic_send(&pt[5]);
-        /*thread_button(&pt[6]);*/
-    }
+    /* records the task of a watchdog reset, before reporting it */
+    swdog_init();
+    report_hang();
+
+    /* event driven scheduling, sleeps when no thread is runnable */
+    sched_run(smclk_busy);
 }
@@ -0,0 +1,127 @@
+/**
+ *  \file   params.c
+ *  \brief  runtime parameters persisted in information memory
+ **/
+
+#include <stdint.h>
+
+#include "flash.h"
+#include "params.h"
+
+/*
+ * Layout of information segment C, one word per parameter:
+ *
+ *   PARAMS_MAGIC | report interval | radio channel | tx power |
+ *   deadband | heartbeat
+ *
+ * A flash word cannot be rewritten without an erase, so every set
+ * erases the segment and writes the whole table back. The node id is
+ * not part of it: it stays in its own byte of segment D.
+ */
+
+#define PARAMS_LOCATION INFOC_START
+#define PARAMS_MAGIC    0x5A02	/* bump the low byte on layout changes */
+/* previous layouts, migrated on load: parameters are only appended */
+#define PARAMS_MAGIC_V1 0x5A01	/* up to the tx power */
+#define PARAMS_COUNT_V1 3
+
+#define PARAMS_INDEX_REPORT_INTERVAL 0
+#define PARAMS_INDEX_RADIO_CHANNEL   1
+#define PARAMS_INDEX_TX_POWER        2
+#define PARAMS_INDEX_DEADBAND        3
+#define PARAMS_INDEX_HEARTBEAT       4
+#define PARAMS_COUNT                 5
+
+static uint16_t params[PARAMS_COUNT];
+
+static int params_index(uint8_t param)
+{
+	switch (param) {
+	case PARAM_REPORT_INTERVAL:
+		return PARAMS_INDEX_REPORT_INTERVAL;
+	case PARAM_RADIO_CHANNEL:
+		return PARAMS_INDEX_RADIO_CHANNEL;
+	case PARAM_TX_POWER:
+		return PARAMS_INDEX_TX_POWER;
+	case PARAM_DEADBAND:
+		return PARAMS_INDEX_DEADBAND;
+	case PARAM_HEARTBEAT:
+		return PARAMS_INDEX_HEARTBEAT;
+	default:
+		return -1;
+	}
+}
+
+void params_load(void)
+{
+	unsigned int *flash = (unsigned int *)PARAMS_LOCATION;
+	int i, count = 0;
+
+	if (flash[0] == PARAMS_MAGIC)
+		count = PARAMS_COUNT;
+	else if (flash[0] == PARAMS_MAGIC_V1)
+		count = PARAMS_COUNT_V1;
+
+	params[PARAMS_INDEX_REPORT_INTERVAL] = PARAMS_DEFAULT_REPORT_INTERVAL;
+	params[PARAMS_INDEX_RADIO_CHANNEL] = PARAMS_DEFAULT_RADIO_CHANNEL;
+	params[PARAMS_INDEX_TX_POWER] = PARAMS_DEFAULT_TX_POWER;
+	params[PARAMS_INDEX_DEADBAND] = PARAMS_DEFAULT_DEADBAND;
+	params[PARAMS_INDEX_HEARTBEAT] = PARAMS_DEFAULT_HEARTBEAT;
+	/* an older table keeps its values, the next set rewrites it in
+	 * the current layout */
+	for (i = 0; i < count; i++)
+		params[i] = flash[i + 1];
+}
+
+static int params_save(void)
+{
+	unsigned int *flash = (unsigned int *)PARAMS_LOCATION;
+	int i;
+
+	flash_erase_segment(flash);
+	for (i = 0; i < PARAMS_COUNT; i++) {
+		if (flash_write_word(&flash[i + 1], params[i]) != 0)
+			return -1;
+	}
+	/* written last, so that an interrupted save reads as blank */
+	return flash_write_word(&flash[0], PARAMS_MAGIC);
+}
+
+int params_get(uint8_t param, uint16_t * value)
+{
+	int i = params_index(param);
+
+	if (i < 0)
+		return UPLINK_STATUS_UNKNOWN;
+	*value = params[i];
+	return UPLINK_STATUS_OK;
+}
+
+int params_set(uint8_t param, uint16_t value)
+{
+	int i = params_index(param);
+
+	if (i < 0)
+		return UPLINK_STATUS_UNKNOWN;
+
+	switch (param) {
+	case PARAM_REPORT_INTERVAL:
+	case PARAM_HEARTBEAT:
+		if (value == 0)
+			return UPLINK_STATUS_INVALID;
+		break;
+	case PARAM_RADIO_CHANNEL:
+	case PARAM_TX_POWER:
+		if (value > 0xFF)
+			return UPLINK_STATUS_INVALID;
+		break;
+	}
+
+	if (params[i] == value)
+		return UPLINK_STATUS_OK;
+
+	params[i] = value;
+	if (params_save() != 0)
+		return UPLINK_STATUS_FLASH;
+	return UPLINK_STATUS_OK;
+}
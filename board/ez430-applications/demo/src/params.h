@@ -0,0 +1,27 @@
+/**
+ *  \file   params.h
+ *  \brief  runtime parameters persisted in information memory
+ **/
+
+#ifndef PARAMS_H
+#define PARAMS_H
+
+#include <stdint.h>
+
+/* PARAM_* identifiers are defined by the uplink protocol */
+#include "uplink.h"
+
+#define PARAMS_DEFAULT_REPORT_INTERVAL 200	/* timer ticks */
+#define PARAMS_DEFAULT_RADIO_CHANNEL   0
+#define PARAMS_DEFAULT_TX_POWER        0xFE	/* 0 dBm */
+#define PARAMS_DEFAULT_DEADBAND        2	/* 1/10 oC */
+#define PARAMS_DEFAULT_HEARTBEAT       30	/* report intervals */
+
+/* loads the parameters from flash, or the defaults on a blank segment */
+void params_load(void);
+/* returns UPLINK_STATUS_OK or UPLINK_STATUS_UNKNOWN */
+int params_get(uint8_t param, uint16_t * value);
+/* stores and persists a value, returns an UPLINK_STATUS_* code */
+int params_set(uint8_t param, uint16_t value);
+
+#endif
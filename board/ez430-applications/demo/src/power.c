@@ -0,0 +1,100 @@
+/**
+ *  \file   power.c
+ *  \brief  battery aware reporting
+ **/
+
+#include <stdint.h>
+
+#include "power.h"
+
+struct power_level {
+	uint8_t avcc_min;	/* 1/10 V, below moves down a level   */
+	uint8_t interval_shift;	/* report interval << shift           */
+	uint8_t patable_max;	/* index in power_patable_dbm         */
+};
+
+/* CC2500 PATABLE settings by increasing output power (data sheet) */
+static const uint8_t power_patable_dbm[] = {
+	0x00,			/* -55 dBm */
+	0x50,			/* -30 dBm */
+	0x44,			/* -28 dBm */
+	0xC0,			/* -26 dBm */
+	0x84,			/* -24 dBm */
+	0x81,			/* -22 dBm */
+	0x46,			/* -20 dBm */
+	0x93,			/* -18 dBm */
+	0x55,			/* -16 dBm */
+	0x8D,			/* -14 dBm */
+	0xC6,			/* -12 dBm */
+	0x97,			/* -10 dBm */
+	0x6E,			/*  -8 dBm */
+	0x7F,			/*  -6 dBm */
+	0xA9,			/*  -4 dBm */
+	0xBB,			/*  -2 dBm */
+	0xFE,			/*   0 dBm */
+	0xFF,			/*  +1 dBm */
+};
+
+#define POWER_NUM_PATABLE \
+	(sizeof(power_patable_dbm) / sizeof(power_patable_dbm[0]))
+
+/* indexed by POWER_LEVEL_* */
+static const struct power_level power_levels[] = {
+	{27, 0, POWER_NUM_PATABLE - 1},	/* full rate, no cap  */
+	{24, 1, 13},			/* half rate, -6 dBm  */
+	{0, 2, 10},			/* 1/4 rate, -12 dBm  */
+};
+
+#define POWER_NUM_LEVELS \
+	(sizeof(power_levels) / sizeof(power_levels[0]))
+
+static uint8_t power_current;
+static uint8_t power_last_avcc;
+
+int power_update(int avcc)
+{
+	uint8_t level = power_current;
+
+	power_last_avcc = avcc < 0 ? 0 : avcc > 0xFF ? 0xFF : avcc;
+	while (level < POWER_NUM_LEVELS - 1 &&
+	       avcc < power_levels[level].avcc_min)
+		level++;
+	while (level > 0 &&
+	       avcc >= power_levels[level - 1].avcc_min + POWER_HYSTERESIS)
+		level--;
+
+	if (level == power_current)
+		return 0;
+	power_current = level;
+	return 1;
+}
+
+uint8_t power_level(void)
+{
+	return power_current;
+}
+
+uint8_t power_avcc(void)
+{
+	return power_last_avcc;
+}
+
+uint16_t power_interval(uint16_t interval)
+{
+	uint8_t shift = power_levels[power_current].interval_shift;
+
+	if (interval > (0xFFFF >> shift))
+		return 0xFFFF;
+	return interval << shift;
+}
+
+uint8_t power_patable(uint8_t patable)
+{
+	uint8_t max = power_levels[power_current].patable_max;
+	uint8_t i;
+
+	for (i = max + 1; i < POWER_NUM_PATABLE; i++)
+		if (power_patable_dbm[i] == patable)
+			return power_patable_dbm[max];
+	return patable;
+}
@@ -0,0 +1,40 @@
+/**
+ *  \file   power.h
+ *  \brief  battery aware reporting
+ *
+ * The node samples AVcc every few reports and moves between power
+ * levels as the battery sags: each level down stretches the report
+ * interval and caps the CC2500 output power, so that the node lasts
+ * longer at a lower rate instead of dying at the nominal one. Moving
+ * back up takes POWER_HYSTERESIS more, a level does not flap on the
+ * noise of the measure.
+ *
+ * Below ~2.2 V the flash can no longer be written (parameters, hang
+ * record), the radio keeps working down to 1.8 V.
+ **/
+
+#ifndef POWER_H
+#define POWER_H
+
+#include <stdint.h>
+
+#define POWER_LEVEL_FULL     0
+#define POWER_LEVEL_LOW      1	/* below 2.7 V */
+#define POWER_LEVEL_CRITICAL 2	/* below 2.4 V */
+
+/* 1/10 V above a threshold to move back up */
+#define POWER_HYSTERESIS     1
+
+/* returns non 0 if the AVcc sample, in 1/10 V, changed the level */
+int power_update(int avcc);
+uint8_t power_level(void);
+/* last AVcc sample in 1/10 V, 0 before the first one */
+uint8_t power_avcc(void);
+
+/* the report interval stretched for the level, saturated */
+uint16_t power_interval(uint16_t interval);
+/* the PATABLE setting capped for the level, settings missing from the
+ * CC2500 data sheet table are left as they are */
+uint8_t power_patable(uint8_t patable);
+
+#endif
@@ -0,0 +1,87 @@
+/**
+ *  \file   ptq.c
+ *  \brief  bounded message queues for protothreads
+ **/
+
+#if defined(__GNUC__) && defined(__MSP430__)
+/* This is the MSPGCC compiler */
+#include <msp430.h>
+#include <legacymsp430.h>
+#elif defined(__IAR_SYSTEMS_ICC__)
+/* This is the IAR compiler */
+#include <io430.h>
+#endif
+
+#include <string.h>
+
+#include "ptq.h"
+#include "ptsched.h"
+
+static void pt_queue_wake(uint8_t thread)
+{
+	if (thread != PT_QUEUE_NO_THREAD)
+		sched_wake(thread);
+}
+
+void pt_queue_init(struct pt_queue *q, void *storage, uint8_t item_size,
+		   uint8_t capacity, uint8_t consumer, uint8_t producer)
+{
+	PT_SEM_INIT(&q->items, 0);
+	PT_SEM_INIT(&q->slots, capacity);
+	q->storage = storage;
+	q->item_size = item_size;
+	q->capacity = capacity;
+	q->head = 0;
+	q->tail = 0;
+	q->consumer = consumer;
+	q->producer = producer;
+	q->dropped = 0;
+}
+
+int pt_queue_try_put(struct pt_queue *q, const void *item)
+{
+	unsigned int state = __get_interrupt_state();
+	__disable_interrupt();
+
+	if (q->slots.count == 0) {
+		__set_interrupt_state(state);
+		return 0;
+	}
+	--q->slots.count;
+	memcpy(q->storage + q->head * q->item_size, item, q->item_size);
+	if (++q->head == q->capacity)
+		q->head = 0;
+	++q->items.count;
+
+	__set_interrupt_state(state);
+	pt_queue_wake(q->consumer);
+	return 1;
+}
+
+int pt_queue_try_get(struct pt_queue *q, void *item)
+{
+	unsigned int state = __get_interrupt_state();
+	__disable_interrupt();
+
+	if (q->items.count == 0) {
+		__set_interrupt_state(state);
+		return 0;
+	}
+	--q->items.count;
+	memcpy(item, q->storage + q->tail * q->item_size, q->item_size);
+	if (++q->tail == q->capacity)
+		q->tail = 0;
+	++q->slots.count;
+
+	__set_interrupt_state(state);
+	pt_queue_wake(q->producer);
+	return 1;
+}
+
+int pt_queue_put_isr(struct pt_queue *q, const void *item)
+{
+	if (pt_queue_try_put(q, item))
+		return 0;
+	q->dropped++;
+	return -1;
+}
@@ -0,0 +1,57 @@
+/**
+ *  \file   ptq.h
+ *  \brief  bounded message queues for protothreads
+ *
+ * A queue copies fixed size items in and out of a storage array given
+ * by the user (capacity items of item_size bytes), items and free slots
+ * are counted by two pt-sem semaphores.
+ *
+ * PT_QUEUE_PUT and PT_QUEUE_GET block the calling protothread while the
+ * queue is full or empty, the item must then be static like any local
+ * state of a protothread. pt_queue_try_put, pt_queue_try_get and
+ * pt_queue_put_isr never block and mask interrupts themselves, they are
+ * safe from interrupt handlers and threads alike. pt_queue_put_isr
+ * counts the items it has to drop.
+ *
+ * A successful put makes the consumer thread runnable, a successful get
+ * the producer thread (ptsched.h), PT_QUEUE_NO_THREAD for none.
+ **/
+
+#ifndef PTQ_H
+#define PTQ_H
+
+#include <stdint.h>
+
+#include "pt.h"
+#include "pt-sem.h"
+
+#define PT_QUEUE_NO_THREAD 0xFF
+
+struct pt_queue {
+	struct pt_sem items;	/* filled slots */
+	struct pt_sem slots;	/* free slots */
+	uint8_t *storage;
+	uint8_t item_size;
+	uint8_t capacity;
+	uint8_t head;		/* next slot to write */
+	uint8_t tail;		/* next slot to read */
+	uint8_t consumer;
+	uint8_t producer;
+	volatile uint8_t dropped;
+};
+
+void pt_queue_init(struct pt_queue *q, void *storage, uint8_t item_size,
+		   uint8_t capacity, uint8_t consumer, uint8_t producer);
+/* returns 1 once item is copied in, 0 if the queue is full */
+int pt_queue_try_put(struct pt_queue *q, const void *item);
+/* returns 1 once the oldest item is copied to item, 0 if empty */
+int pt_queue_try_get(struct pt_queue *q, void *item);
+/* returns non 0 if the queue is full, the item is then dropped */
+int pt_queue_put_isr(struct pt_queue *q, const void *item);
+/* number of items waiting */
+#define pt_queue_count(q) ((q)->items.count)
+
+#define PT_QUEUE_PUT(pt, q, item) PT_WAIT_UNTIL(pt, pt_queue_try_put(q, item))
+#define PT_QUEUE_GET(pt, q, item) PT_WAIT_UNTIL(pt, pt_queue_try_get(q, item))
+
+#endif
@@ -0,0 +1,229 @@
+/**
+ *  \file   ptsched.c
+ *  \brief  event driven protothread scheduler
+ **/
+
+#if defined(__GNUC__) && defined(__MSP430__)
+/* This is the MSPGCC compiler */
+#include <msp430.h>
+#include <legacymsp430.h>
+#elif defined(__IAR_SYSTEMS_ICC__)
+/* This is the IAR compiler */
+#include <io430.h>
+#endif
+
+#include <stdio.h>
+
+#include "lpm_compat.h"
+#include "fmt.h"
+#include "clock.h"
+#include "ptsched.h"
+
+static volatile uint8_t sched_runnable;
+/* tasks that exited, never run again */
+static uint8_t sched_done;
+/* wakes the periodic tasks */
+static struct timer_event sched_timer;
+
+#if defined(PROFILING)
+void sched_stats_get(uint8_t id, struct sched_stats *stats)
+{
+	unsigned int state = __get_interrupt_state();
+	__disable_interrupt();
+	*stats = sched_state[id].stats;
+	__set_interrupt_state(state);
+}
+
+void sched_stats_reset(void)
+{
+	uint8_t id, i;
+	unsigned int state = __get_interrupt_state();
+	__disable_interrupt();
+
+	for (id = 0; id < sched_num_tasks; id++) {
+		sched_state[id].stats.runs = 0;
+		sched_state[id].stats.max = 0;
+		sched_state[id].stats.total = 0;
+		for (i = 0; i < SCHED_LAT_BUCKETS; i++)
+			sched_state[id].stats.lat[i] = 0;
+	}
+
+	__set_interrupt_state(state);
+}
+
+static void sched_account(uint8_t id, uint16_t woken_at, uint16_t start,
+			  uint16_t end)
+{
+	struct sched_stats *s = &sched_state[id].stats;
+	uint16_t cycles = end - start;
+	uint16_t lat = (start - woken_at) >> SCHED_LAT_SHIFT;
+	uint8_t bucket = 0;
+
+	while (lat != 0 && bucket < SCHED_LAT_BUCKETS - 1) {
+		lat >>= 2;
+		bucket++;
+	}
+
+	if (s->runs != 0xFFFF)
+		s->runs++;
+	if (cycles > s->max)
+		s->max = cycles;
+	s->total += cycles;
+	if (s->lat[bucket] != 0xFFFF)
+		s->lat[bucket]++;
+}
+
+void sched_dump(void)
+{
+	struct sched_stats s;
+	uint8_t id, i;
+
+	fmt_str("sched,smclk_khz,");
+	fmt_u16_dec(get_smclk_freq_hz() / 1000);
+	fmt_eol();
+
+	for (id = 0; id < sched_num_tasks; id++) {
+		sched_stats_get(id, &s);
+		if (s.runs == 0)
+			continue;
+
+		fmt_str("sched,");
+		fmt_u16_dec(id);
+		fmt_str(",runs,");
+		fmt_u16_dec(s.runs);
+		fmt_str(",max,");
+		fmt_u16_dec(s.max);
+		fmt_str(",total,0x");
+		fmt_u16_hex(s.total >> 16);
+		fmt_u16_hex(s.total & 0xFFFF);
+		fmt_str(",lat");
+		for (i = 0; i < SCHED_LAT_BUCKETS; i++) {
+			fmt_str(",");
+			fmt_u16_dec(s.lat[i]);
+		}
+		fmt_eol();
+	}
+}
+#endif
+
+void sched_wake(uint8_t id)
+{
+	unsigned int state;
+
+	if (id >= sched_num_tasks)
+		return;
+
+	state = __get_interrupt_state();
+	__disable_interrupt();
+#if defined(PROFILING)
+	if (!(sched_runnable & (1 << id)))
+		sched_state[id].woken_at = TBR;
+#endif
+	if (!(sched_done & (1 << id)))
+		sched_runnable |= 1 << id;
+	__set_interrupt_state(state);
+}
+
+/* wakes the periodic tasks that are due, then programs sched_timer for
+ * the next one, missed periods are skipped */
+static int sched_timer_cb(struct timer_event *ev)
+{
+	uint32_t now = timer_service_now();
+	uint32_t next = 0;
+	uint32_t period;
+	uint8_t id, periodic = 0, wakeup = 0;
+	struct sched_task_state *s;
+
+	for (id = 0; id < sched_num_tasks; id++) {
+		if (sched_tasks[id].period_ms == 0)
+			continue;
+		s = &sched_state[id];
+		if ((int32_t) (now - s->due) >= 0) {
+			period = timer_ms_to_ticks(sched_tasks[id].period_ms);
+			s->due += period;
+			if ((int32_t) (now - s->due) >= 0)
+				s->due = now + period;
+			sched_wake(id);
+			wakeup = 1;
+		}
+		if (!periodic || (int32_t) (s->due - next) < 0)
+			next = s->due;
+		periodic = 1;
+	}
+
+	if (periodic)
+		timer_event_start(&sched_timer, next - now, 0, sched_timer_cb);
+	return wakeup;
+}
+
+/* sorts the tasks by priority, equal priorities in table order */
+static void sched_order(void)
+{
+	uint8_t i, j;
+
+	for (i = 0; i < sched_num_tasks; i++) {
+		for (j = i; j > 0; j--) {
+			if (sched_tasks[sched_state[j - 1].order].priority <=
+			    sched_tasks[i].priority)
+				break;
+			sched_state[j].order = sched_state[j - 1].order;
+		}
+		sched_state[j].order = i;
+	}
+}
+
+void sched_run(clock_busy_cb smclk_busy)
+{
+	uint8_t id, rank;
+	char ret;
+#if defined(PROFILING)
+	uint16_t woken_at, start;
+#endif
+
+	sched_order();
+	for (id = 0; id < sched_num_tasks; id++) {
+		PT_INIT(&sched_state[id].pt);
+		/* first period from now on */
+		sched_state[id].due = timer_service_now();
+		sched_wake(id);
+	}
+	sched_timer_cb(&sched_timer);
+
+	while (1) {
+		/* checked with interrupts disabled, LPM_GIE enables them
+		 * while going to sleep so that no wake up is lost */
+		__disable_interrupt();
+		if (sched_runnable == 0) {
+			if (smclk_busy != NULL && smclk_busy())
+				LPM_GIE(0);
+			else
+				LPM_GIE(3);
+			continue;
+		}
+		/* most urgent runnable task */
+		for (rank = 0; rank < sched_num_tasks; rank++) {
+			id = sched_state[rank].order;
+			if (sched_runnable & (1 << id))
+				break;
+		}
+		sched_runnable &= ~(1 << id);
+#if defined(PROFILING)
+		woken_at = sched_state[id].woken_at;
+#endif
+		__enable_interrupt();
+
+		swdog_begin(id, sched_tasks[id].deadline);
+#if defined(PROFILING)
+		start = TBR;
+		ret = sched_tasks[id].thread(&sched_state[id].pt);
+		sched_account(id, woken_at, start, TBR);
+#else
+		ret = sched_tasks[id].thread(&sched_state[id].pt);
+#endif
+		swdog_end();
+		if (ret == PT_YIELDED)
+			sched_wake(id);
+		else if (ret == PT_EXITED || ret == PT_ENDED)
+			sched_done |= 1 << id;
+	}
+}
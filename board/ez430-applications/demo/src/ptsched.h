@@ -0,0 +1,153 @@
+/**
+ *  \file   ptsched.h
+ *  \brief  event driven protothread scheduler
+ *
+ * Threads are only run once made runnable by sched_wake, typically from
+ * the interrupt (or timer event callback) that changes what they wait
+ * for. A thread returning PT_YIELDED stays runnable, a waiting thread
+ * sleeps until the next sched_wake. With no runnable thread the CPU
+ * sleeps in LPM3, or in LPM0 while the smclk_busy callback given to
+ * sched_run returns non 0.
+ *
+ * The waking interrupt must leave LPM itself (LPM_OFF_ON_EXIT, or a
+ * timer event callback returning non 0), sched_wake does not.
+ *
+ * Profiling builds (-DPROFILING, see prof.h) also account per thread,
+ * in SMCLK cycles of timer B, the number of runs, the total and the
+ * longest run time, and a histogram of the latency between the first
+ * sched_wake and the following run. As for the probes, a single run or
+ * latency must stay below 65536 cycles (8 ms at 8 MHz) to be exact.
+ **/
+
+#ifndef PTSCHED_H
+#define PTSCHED_H
+
+#include <stdint.h>
+
+#include "pt.h"
+#include "clock.h"
+#include "timer.h"
+#include "swdog.h"
+
+#define SCHED_MAX_THREADS 8
+/* id of a disabled task, sched_wake ignores it */
+#define SCHED_NO_THREAD   0xFF
+
+typedef char (*sched_thread) (struct pt *);
+
+/* ************************************************** */
+/* Task table                                         */
+/* ************************************************** */
+
+/*
+ * The application lists its tasks once, as
+ *
+ *   #define APP_TASKS(TASK) \
+ *       TASK(NAME, thread, enabled, period_ms, priority, deadline_ms) \
+ *       ...
+ *
+ * enabled is a literal 0 or 1. A run lasting more than deadline_ms
+ * resets the MCU (swdog.h), 0 for no deadline. A task with a period_ms
+ * other than 0 is also woken every period_ms, it waits for the next one
+ * with PT_WAIT_NEXT_PERIOD. Among runnable tasks the lowest priority
+ * value runs first, the scheduler looks again for the most urgent task
+ * after each run.
+ *
+ * SCHED_TASK_IDS(APP_TASKS) defines a THREAD_<NAME> id per task, from 0
+ * for the enabled ones and SCHED_NO_THREAD for the others, and
+ * SCHED_TASK_TABLE(APP_TASKS), once the threads are declared, the task
+ * table in flash and the task states in RAM, for the enabled tasks only.
+ */
+
+struct sched_task {
+	sched_thread thread;
+	uint16_t period_ms;
+	uint8_t priority;
+	uint8_t deadline;	/* SWDOG_DEADLINE */
+};
+
+#if defined(PROFILING)
+/* latency bucket i counts latencies below 64 << 2i cycles, the last
+ * one all the longer ones */
+#define SCHED_LAT_BUCKETS 6	/* UPLINK_SCHED_LAT_BUCKETS */
+#define SCHED_LAT_SHIFT   6
+
+struct sched_stats {
+	uint16_t runs;		/* saturates at 0xFFFF */
+	uint16_t max;		/* longest run */
+	uint32_t total;		/* sum of the runs */
+	uint16_t lat[SCHED_LAT_BUCKETS];	/* saturate at 0xFFFF */
+};
+#endif
+
+struct sched_task_state {
+	struct pt pt;
+	uint8_t order;		/* index of the task run at this rank */
+	uint32_t due;		/* next period, in timer ticks */
+#if defined(PROFILING)
+	/* TBR at the first sched_wake of the not yet runnable task */
+	uint16_t woken_at;
+	struct sched_stats stats;
+#endif
+};
+
+extern const struct sched_task sched_tasks[];
+extern struct sched_task_state sched_state[];
+extern const uint8_t sched_num_tasks;
+
+#define SCHED_ID_0(name)
+#define SCHED_ID_1(name) THREAD_ ## name,
+#define SCHED_NO_ID_0(name) THREAD_ ## name = SCHED_NO_THREAD,
+#define SCHED_NO_ID_1(name)
+#define SCHED_ENTRY_0(thread, period, prio, deadline)
+#define SCHED_ENTRY_1(thread, period, prio, deadline) \
+	{ thread, period, prio, SWDOG_DEADLINE(deadline) },
+
+#define SCHED_ID(name, thread, enabled, period, prio, deadline) \
+	SCHED_ID_ ## enabled(name)
+#define SCHED_NO_ID(name, thread, enabled, period, prio, deadline) \
+	SCHED_NO_ID_ ## enabled(name)
+#define SCHED_ENTRY(name, thread, enabled, period, prio, deadline) \
+	SCHED_ENTRY_ ## enabled(thread, period, prio, deadline)
+
+#define SCHED_TASK_IDS(LIST) \
+	enum { LIST(SCHED_ID) SCHED_NUM_TASKS }; \
+	enum { LIST(SCHED_NO_ID) SCHED_NO_ID_END }
+
+#define SCHED_TASK_TABLE(LIST) \
+	typedef char sched_too_many_tasks \
+	    [SCHED_NUM_TASKS <= SCHED_MAX_THREADS ? 1 : -1]; \
+	const struct sched_task sched_tasks[SCHED_NUM_TASKS] = { \
+		LIST(SCHED_ENTRY) \
+	}; \
+	struct sched_task_state sched_state[SCHED_NUM_TASKS]; \
+	const uint8_t sched_num_tasks = SCHED_NUM_TASKS
+
+/* like PT_YIELD, but the task is only run again once woken */
+#define PT_WAIT_NEXT_PERIOD(pt) \
+	do { \
+		PT_YIELD_FLAG = 0; \
+		LC_SET((pt)->lc); \
+		if (PT_YIELD_FLAG == 0) \
+			return PT_WAITING; \
+	} while (0)
+
+/* ************************************************** */
+/* Scheduler                                          */
+/* ************************************************** */
+
+/* makes thread id runnable, safe from interrupts */
+void sched_wake(uint8_t id);
+/* runs the task table forever, every task is runnable first */
+void sched_run(clock_busy_cb smclk_busy);
+
+#if defined(PROFILING)
+/* copies the statistics of thread id, safe against interrupts */
+void sched_stats_get(uint8_t id, struct sched_stats *stats);
+void sched_stats_reset(void);
+/* prints "sched,<id>,runs,<n>,max,<c>,total,<hex>,lat,<n>,...,<n>"
+ * lines for the threads that ran, cycles are SMCLK cycles */
+void sched_dump(void);
+#endif
+
+#endif
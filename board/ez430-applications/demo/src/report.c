@@ -0,0 +1,37 @@
+/**
+ *  \file   report.c
+ *  \brief  change driven reporting policy
+ **/
+
+#include <stdint.h>
+
+#include "report.h"
+
+void report_init(struct report *r, uint16_t deadband, uint16_t heartbeat)
+{
+	r->deadband = deadband;
+	r->heartbeat = heartbeat ? heartbeat : 1;
+	report_force(r);
+}
+
+void report_force(struct report *r)
+{
+	r->held = 0;
+	r->force = 1;
+}
+
+int report_sample(struct report *r, int16_t value)
+{
+	/* in 32 bits, a difference of two int16_t may not fit */
+	int32_t delta = (int32_t) value - r->last;
+
+	if (delta < 0)
+		delta = -delta;
+	if (!r->force && delta <= r->deadband && ++r->held < r->heartbeat)
+		return 0;
+
+	r->last = value;
+	r->held = 0;
+	r->force = 0;
+	return 1;
+}
@@ -0,0 +1,36 @@
+/**
+ *  \file   report.h
+ *  \brief  change driven reporting policy
+ *
+ * A reading is sampled at every report interval but only sent when it
+ * moved by more than the deadband since the last value sent, or when
+ * heartbeat samples in a row were kept back. A node therefore stays
+ * silent for at most heartbeat report intervals: once the sink knows
+ * the policy, a longer silence is a loss, not a steady reading.
+ *
+ * A deadband of 0 sends every change, a heartbeat of 1 every sample.
+ **/
+
+#ifndef REPORT_H
+#define REPORT_H
+
+#include <stdint.h>
+
+struct report {
+	int16_t last;		/* last value sent               */
+	uint16_t deadband;	/* in the units of the value     */
+	uint16_t heartbeat;	/* samples, at least 1           */
+	uint16_t held;		/* samples kept back since       */
+	uint8_t force;		/* the next sample is sent       */
+};
+
+/* sets the policy, the next sample is sent whatever its value */
+void report_init(struct report *r, uint16_t deadband, uint16_t heartbeat);
+
+/* the next sample is sent whatever its value */
+void report_force(struct report *r);
+
+/* returns non 0 if value is to be sent, it is then the new reference */
+int report_sample(struct report *r, int16_t value);
+
+#endif
@@ -0,0 +1,129 @@
+/**
+ *  \file   swdog.c
+ *  \brief  per-task software watchdog
+ **/
+
+#if defined(__GNUC__) && defined(__MSP430__)
+/* This is the MSPGCC compiler */
+#include <msp430.h>
+#include <legacymsp430.h>
+#elif defined(__IAR_SYSTEMS_ICC__)
+/* This is the IAR compiler */
+#include <io430.h>
+#endif
+
+#include "io_compat.h"
+#include "flash.h"
+#include "timer.h"
+#include "swdog.h"
+
+/*
+ * Layout of information segment B:
+ *
+ *   SWDOG_MAGIC | task id | hang count
+ *
+ * As for the parameters, the magic is written last.
+ */
+
+#define SWDOG_LOCATION INFOB_START
+#define SWDOG_MAGIC    0x5A10
+
+/* watchdog mode on ACLK (VLO), the interval in the low bits */
+#define SWDOG_WDTCTL   (WDTPW | WDTCNTCL | WDTSSEL)
+
+/* the task running, and its complement: garbage after a power up does
+ * not pass for a task id */
+static NOINIT volatile uint8_t swdog_task;
+static NOINIT volatile uint8_t swdog_task_check;
+/* of the running task, 0 while the watchdog is held */
+static uint8_t swdog_deadline;
+
+/* restarts the idle watchdog twice per period */
+static struct timer_event swdog_idle_timer;
+
+static void swdog_set_task(uint8_t task)
+{
+	swdog_task = task;
+	swdog_task_check = ~task;
+}
+
+static void swdog_record(uint8_t task)
+{
+	unsigned int *flash = (unsigned int *)SWDOG_LOCATION;
+	unsigned int count = 0;
+
+	if (flash[0] == SWDOG_MAGIC)
+		count = flash[2];
+	if (count < 0xFF)
+		count++;
+
+	flash_erase_segment(flash);
+	flash_write_word(&flash[1], task);
+	flash_write_word(&flash[2], count);
+	flash_write_word(&flash[0], SWDOG_MAGIC);
+}
+
+void swdog_checkin(void)
+{
+	if (swdog_deadline != 0)
+		WDTCTL = SWDOG_WDTCTL | (swdog_deadline - 1);
+}
+
+/* from the timer A interrupt, which a hung handler also blocks */
+static int swdog_idle_kick(struct timer_event *ev)
+{
+	if (swdog_task == SWDOG_IDLE)
+		swdog_checkin();
+	return 0;
+}
+
+static void swdog_idle(void)
+{
+	swdog_set_task(SWDOG_IDLE);
+	swdog_deadline = SWDOG_DEADLINE(0xFFFF);
+	swdog_checkin();
+}
+
+void swdog_init(void)
+{
+	if (IFG1 & WDTIFG) {
+		IFG1 &= ~WDTIFG;
+		swdog_record((uint8_t) ~swdog_task_check == swdog_task ?
+			     swdog_task : SWDOG_NO_TASK);
+	}
+
+	BCSCTL3 |= LFXT1S_2;	// LFXT1 = VLO
+	timer_event_start(&swdog_idle_timer, 16384, 16384, swdog_idle_kick);
+	swdog_idle();
+}
+
+void swdog_begin(uint8_t task, uint8_t deadline)
+{
+	swdog_set_task(task);
+	swdog_deadline = deadline;
+	if (deadline == 0)
+		WDTCTL = WDTPW | WDTHOLD;
+	else
+		swdog_checkin();
+}
+
+void swdog_end(void)
+{
+	swdog_idle();
+}
+
+int swdog_last_hang(uint8_t * task, uint8_t * count)
+{
+	unsigned int *flash = (unsigned int *)SWDOG_LOCATION;
+
+	if (flash[0] != SWDOG_MAGIC)
+		return 0;
+	*task = flash[1];
+	*count = flash[2];
+	return 1;
+}
+
+void swdog_clear(void)
+{
+	flash_erase_segment((unsigned int *)SWDOG_LOCATION);
+}
@@ -0,0 +1,64 @@
+/**
+ *  \file   swdog.h
+ *  \brief  per-task software watchdog
+ *
+ * sched_run supervises each run of a task with a deadline: the WDT+
+ * runs in watchdog mode, restarted at the task deadline when the task
+ * starts, and its reset catches any hang, interrupts disabled or in an
+ * interrupt handler included. The running task id is kept in RAM left
+ * alone by the startup code, swdog_init finds it after a watchdog
+ * reset and records it in information segment B. Returning to the
+ * scheduler checks the task in, swdog_checkin does it during a long
+ * legitimate operation.
+ *
+ * Between runs the watchdog keeps running on its longest period, a
+ * timer event restarts it: a hang in an interrupt handler while the
+ * scheduler is idle is recorded as SWDOG_IDLE. A hang in an interrupt
+ * handler during a run is recorded as the running task.
+ *
+ * The WDT+ only counts 64, 512, 8192 or 32768 VLO periods, a deadline
+ * is rounded up to one of them at compile time with the nominal VLO
+ * frequency (5.3 ms, 43 ms, 683 ms, 2.7 s), and capped to the longest.
+ * The VLO may run from 4 to 20 kHz, so a deadline is a coarse bound:
+ * leave a margin.
+ **/
+
+#ifndef SWDOG_H
+#define SWDOG_H
+
+#include <stdint.h>
+
+#include "clock.h"
+#include "watchdog.h"
+
+/* a WDT+ period of n VLO periods, in ms */
+#define SWDOG_VLO_MS(n) ((uint32_t) (n) * 1000 / VLO_FREQ_NOMINAL)
+
+/* deadline for swdog_begin: 1 + WATCHDOG_INTERVAL_*, 0 for none */
+#define SWDOG_DEADLINE(ms) ((ms) == 0 ? 0 : \
+	(ms) <= SWDOG_VLO_MS(64) ? 1 + WATCHDOG_INTERVAL_64 : \
+	(ms) <= SWDOG_VLO_MS(512) ? 1 + WATCHDOG_INTERVAL_512 : \
+	(ms) <= SWDOG_VLO_MS(8192) ? 1 + WATCHDOG_INTERVAL_8192 : \
+	1 + WATCHDOG_INTERVAL_32768)
+
+/* task ids of a record, besides the scheduler ones */
+#define SWDOG_IDLE    0xFE	/* between runs, in an interrupt handler */
+#define SWDOG_NO_TASK 0xFF
+
+/* records the task of a watchdog reset, then supervises the scheduler
+ * idle time, once the timer service runs and before sched_run */
+void swdog_init(void);
+
+/* supervises task until swdog_end, held during the run if deadline
+ * is 0 */
+void swdog_begin(uint8_t task, uint8_t deadline);
+void swdog_end(void);
+/* restarts the deadline of the running task */
+void swdog_checkin(void);
+
+/* returns non 0 if a hang was recorded, with the task id of the last
+ * one and the number of hangs since the record was cleared */
+int swdog_last_hang(uint8_t * task, uint8_t * count);
+void swdog_clear(void);
+
+#endif
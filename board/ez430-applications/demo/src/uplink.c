@@ -0,0 +1,180 @@
+/**
+ *  \file   uplink.c
+ *  \brief  binary framed uplink from the sink to the host
+ **/
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "uplink.h"
+
+static void uplink_put(uint8_t data)
+{
+	switch (data) {
+	case UPLINK_SLIP_END:
+		putchar(UPLINK_SLIP_ESC);
+		putchar(UPLINK_SLIP_ESC_END);
+		break;
+	case UPLINK_SLIP_ESC:
+		putchar(UPLINK_SLIP_ESC);
+		putchar(UPLINK_SLIP_ESC_ESC);
+		break;
+	default:
+		putchar(data);
+		break;
+	}
+}
+
+void uplink_send(uint8_t type, uint16_t timestamp,
+		 const uint8_t * payload, uint8_t length)
+{
+	uint16_t crc = UPLINK_CRC16_INIT;
+	uint8_t i;
+
+	/* a leading END flushes any line noise on the host side */
+	putchar(UPLINK_SLIP_END);
+
+	crc = uplink_crc16_update(crc, type);
+	uplink_put(type);
+	crc = uplink_crc16_update(crc, timestamp & 0xFF);
+	uplink_put(timestamp & 0xFF);
+	crc = uplink_crc16_update(crc, timestamp >> 8);
+	uplink_put(timestamp >> 8);
+
+	for (i = 0; i < length; i++) {
+		crc = uplink_crc16_update(crc, payload[i]);
+		uplink_put(payload[i]);
+	}
+
+	uplink_put(crc & 0xFF);
+	uplink_put(crc >> 8);
+	putchar(UPLINK_SLIP_END);
+}
+
+void uplink_send_temperature(uint16_t timestamp, uint8_t node_id,
+			     int16_t temperature, int8_t rssi, uint8_t hops,
+			     uint8_t battery)
+{
+	uint8_t payload[UPLINK_TEMPERATURE_LEN];
+
+	payload[UPLINK_TEMPERATURE_NODE_ID] = node_id;
+	payload[UPLINK_TEMPERATURE_VALUE] = temperature & 0xFF;
+	payload[UPLINK_TEMPERATURE_VALUE + 1] = (uint16_t)temperature >> 8;
+	payload[UPLINK_TEMPERATURE_RSSI] = rssi;
+	payload[UPLINK_TEMPERATURE_HOPS] = hops;
+	payload[UPLINK_TEMPERATURE_BATTERY] = battery;
+
+	uplink_send(UPLINK_TYPE_TEMPERATURE, timestamp, payload,
+		    UPLINK_TEMPERATURE_LEN);
+}
+
+void uplink_send_report_policy(uint16_t timestamp, uint8_t node_id,
+				uint16_t max_silence)
+{
+	uint8_t payload[UPLINK_POLICY_LEN];
+
+	payload[UPLINK_POLICY_NODE_ID] = node_id;
+	payload[UPLINK_POLICY_MAX_SILENCE] = max_silence & 0xFF;
+	payload[UPLINK_POLICY_MAX_SILENCE + 1] = max_silence >> 8;
+
+	uplink_send(UPLINK_TYPE_POLICY, timestamp, payload,
+		    UPLINK_POLICY_LEN);
+}
+
+void uplink_send_param(uint16_t timestamp, uint8_t param, uint8_t status,
+		       uint16_t value)
+{
+	uint8_t payload[UPLINK_PARAM_LEN];
+
+	payload[UPLINK_PARAM_PARAM] = param;
+	payload[UPLINK_PARAM_STATUS] = status;
+	payload[UPLINK_PARAM_VALUE] = value & 0xFF;
+	payload[UPLINK_PARAM_VALUE + 1] = value >> 8;
+
+	uplink_send(UPLINK_TYPE_PARAM, timestamp, payload, UPLINK_PARAM_LEN);
+}
+
+static void uplink_put16(uint8_t * payload, uint16_t value)
+{
+	payload[0] = value & 0xFF;
+	payload[1] = value >> 8;
+}
+
+void uplink_send_prof(uint16_t timestamp, uint8_t id, uint16_t smclk_khz,
+		      uint16_t count, uint16_t min, uint16_t max,
+		      uint32_t total)
+{
+	uint8_t payload[UPLINK_PROF_LEN];
+
+	payload[UPLINK_PROF_ID] = id;
+	uplink_put16(payload + UPLINK_PROF_SMCLK_KHZ, smclk_khz);
+	uplink_put16(payload + UPLINK_PROF_COUNT, count);
+	uplink_put16(payload + UPLINK_PROF_MIN, min);
+	uplink_put16(payload + UPLINK_PROF_MAX, max);
+	uplink_put16(payload + UPLINK_PROF_TOTAL, total & 0xFFFF);
+	uplink_put16(payload + UPLINK_PROF_TOTAL + 2, total >> 16);
+
+	uplink_send(UPLINK_TYPE_PROF, timestamp, payload, UPLINK_PROF_LEN);
+}
+
+void uplink_send_sched(uint16_t timestamp, uint8_t id, uint16_t smclk_khz,
+		       uint16_t runs, uint16_t max, uint32_t total)
+{
+	uint8_t payload[UPLINK_SCHED_LEN];
+
+	payload[UPLINK_SCHED_ID] = id;
+	uplink_put16(payload + UPLINK_SCHED_SMCLK_KHZ, smclk_khz);
+	uplink_put16(payload + UPLINK_SCHED_RUNS, runs);
+	uplink_put16(payload + UPLINK_SCHED_MAX, max);
+	uplink_put16(payload + UPLINK_SCHED_TOTAL, total & 0xFFFF);
+	uplink_put16(payload + UPLINK_SCHED_TOTAL + 2, total >> 16);
+
+	uplink_send(UPLINK_TYPE_SCHED, timestamp, payload, UPLINK_SCHED_LEN);
+}
+
+void uplink_send_sched_lat(uint16_t timestamp, uint8_t id,
+			   const uint16_t * lat)
+{
+	uint8_t payload[UPLINK_SCHED_LAT_LEN];
+	uint8_t i;
+
+	payload[UPLINK_SCHED_LAT_ID] = id;
+	for (i = 0; i < UPLINK_SCHED_LAT_BUCKETS; i++)
+		uplink_put16(payload + UPLINK_SCHED_LAT_COUNT + 2 * i, lat[i]);
+
+	uplink_send(UPLINK_TYPE_SCHED_LAT, timestamp, payload,
+		    UPLINK_SCHED_LAT_LEN);
+}
+
+int uplink_unslip(uint8_t * frame, int length)
+{
+	uint16_t crc = UPLINK_CRC16_INIT;
+	int i, n = 0;
+
+	for (i = 0; i < length; i++) {
+		if (frame[i] == UPLINK_SLIP_ESC) {
+			if (++i == length)
+				return -1;
+			if (frame[i] == UPLINK_SLIP_ESC_END)
+				frame[n++] = UPLINK_SLIP_END;
+			else if (frame[i] == UPLINK_SLIP_ESC_ESC)
+				frame[n++] = UPLINK_SLIP_ESC;
+			else
+				return -1;
+		} else {
+			frame[n++] = frame[i];
+		}
+	}
+
+	if (n == 0)
+		return 0;
+	if (n < UPLINK_HEADER_LEN + UPLINK_CRC_LEN)
+		return -1;
+
+	for (i = 0; i < n - UPLINK_CRC_LEN; i++)
+		crc = uplink_crc16_update(crc, frame[i]);
+	if ((crc & 0xFF) != frame[n - 2] || (crc >> 8) != frame[n - 1])
+		return -1;
+
+	return n - UPLINK_CRC_LEN;
+}
@@ -0,0 +1,155 @@
+/**
+ *  \file   uplink.h
+ *  \brief  binary framed uplink from the sink to the host
+ *
+ * A frame is SLIP encoded (RFC 1055) on the UART:
+ *
+ *   END | type | timestamp (2) | payload (n) | crc16 (2) | END
+ *
+ * Multi-byte fields are little endian. The timestamp counts
+ * UPLINK_TIMESTAMP_MS milliseconds since boot and wraps around.
+ * The crc is CRC-16/CCITT (poly 0x1021, init 0xFFFF) over type,
+ * timestamp and payload, before SLIP escaping.
+ *
+ * The host sends commands to the sink with the same framing, the
+ * timestamp of a command is ignored.
+ *
+ * This header is shared with the host decoder (tools/ezconsole),
+ * keep it free of msp430 specifics.
+ **/
+
+#ifndef UPLINK_H
+#define UPLINK_H
+
+#include <stdint.h>
+
+#define UPLINK_SLIP_END     0xC0
+#define UPLINK_SLIP_ESC     0xDB
+#define UPLINK_SLIP_ESC_END 0xDC
+#define UPLINK_SLIP_ESC_ESC 0xDD
+
+#define UPLINK_TIMESTAMP_MS 10
+
+#define UPLINK_HEADER_LEN   3	/* type + timestamp */
+#define UPLINK_CRC_LEN      2
+#define UPLINK_PAYLOAD_MAX  16
+#define UPLINK_FRAME_MAX    (UPLINK_HEADER_LEN + UPLINK_PAYLOAD_MAX + UPLINK_CRC_LEN)
+
+/* frame types, sink to host */
+#define UPLINK_TYPE_TEMPERATURE 0x02
+#define UPLINK_TYPE_POLICY      0x03	/* at boot and on policy changes */
+#define UPLINK_TYPE_PARAM       0x10	/* reply to a get or set command */
+#define UPLINK_TYPE_PROF        0x11	/* reply to a prof command       */
+#define UPLINK_TYPE_SCHED       0x12	/* reply to a sched command      */
+#define UPLINK_TYPE_SCHED_LAT   0x13	/* reply to a sched command      */
+/* frame types, host to sink */
+#define UPLINK_TYPE_CMD_GET     0x20
+#define UPLINK_TYPE_CMD_SET     0x21
+#define UPLINK_TYPE_CMD_PROF    0x22	/* profiling builds only         */
+#define UPLINK_TYPE_CMD_SCHED   0x23	/* profiling builds only         */
+
+/* UPLINK_TYPE_TEMPERATURE payload */
+#define UPLINK_TEMPERATURE_NODE_ID 0	/* 1 byte                    */
+#define UPLINK_TEMPERATURE_VALUE   1	/* 2 bytes, signed, 1/10 oC  */
+#define UPLINK_TEMPERATURE_RSSI    3	/* 1 byte, signed dBm        */
+#define UPLINK_TEMPERATURE_HOPS    4	/* 1 byte                    */
+#define UPLINK_TEMPERATURE_BATTERY 5	/* 1 byte, 1/10 V, 0 unknown */
+#define UPLINK_TEMPERATURE_LEN     6
+
+/* UPLINK_TYPE_POLICY payload, a node sends a reading at least
+ * every max silence (report.h), a longer gap is a loss */
+#define UPLINK_POLICY_NODE_ID      0	/* 1 byte                    */
+#define UPLINK_POLICY_MAX_SILENCE  1	/* 2 bytes, seconds          */
+#define UPLINK_POLICY_LEN          3
+
+/* UPLINK_TYPE_CMD_GET / UPLINK_TYPE_CMD_SET / UPLINK_TYPE_CMD_PROF /
+ * UPLINK_TYPE_CMD_SCHED payload, a non 0 prof or sched value clears the
+ * statistics after the reply */
+#define UPLINK_CMD_PARAM           0	/* 1 byte, PARAM_*           */
+#define UPLINK_CMD_VALUE           1	/* 2 bytes, ignored by get   */
+#define UPLINK_CMD_LEN             3
+
+/* UPLINK_TYPE_PARAM payload */
+#define UPLINK_PARAM_PARAM         0	/* 1 byte, PARAM_*           */
+#define UPLINK_PARAM_STATUS        1	/* 1 byte, UPLINK_STATUS_*   */
+#define UPLINK_PARAM_VALUE         2	/* 2 bytes, current value    */
+#define UPLINK_PARAM_LEN           4
+
+/* UPLINK_TYPE_PROF payload, one frame per probe hit (see prof.h) */
+#define UPLINK_PROF_ID             0	/* 1 byte, probe id          */
+#define UPLINK_PROF_SMCLK_KHZ      1	/* 2 bytes, cycles unit      */
+#define UPLINK_PROF_COUNT          3	/* 2 bytes                   */
+#define UPLINK_PROF_MIN            5	/* 2 bytes, cycles           */
+#define UPLINK_PROF_MAX            7	/* 2 bytes, cycles           */
+#define UPLINK_PROF_TOTAL          9	/* 4 bytes, cycles           */
+#define UPLINK_PROF_LEN            13
+
+/* UPLINK_TYPE_SCHED payload, one frame per thread that ran (ptsched.h) */
+#define UPLINK_SCHED_ID            0	/* 1 byte, thread id         */
+#define UPLINK_SCHED_SMCLK_KHZ     1	/* 2 bytes, cycles unit      */
+#define UPLINK_SCHED_RUNS          3	/* 2 bytes                   */
+#define UPLINK_SCHED_MAX           5	/* 2 bytes, cycles           */
+#define UPLINK_SCHED_TOTAL         7	/* 4 bytes, cycles           */
+#define UPLINK_SCHED_LEN           11
+
+/* UPLINK_TYPE_SCHED_LAT payload, follows the UPLINK_TYPE_SCHED frame
+ * of the same thread, bucket i counts the wake to run latencies below
+ * 64 << 2i cycles, the last one all the longer ones */
+#define UPLINK_SCHED_LAT_BUCKETS   6
+#define UPLINK_SCHED_LAT_ID        0	/* 1 byte, thread id         */
+#define UPLINK_SCHED_LAT_COUNT     1	/* 2 bytes per bucket        */
+#define UPLINK_SCHED_LAT_LEN       (1 + 2 * UPLINK_SCHED_LAT_BUCKETS)
+
+#define UPLINK_STATUS_OK           0
+#define UPLINK_STATUS_UNKNOWN      1	/* no such parameter         */
+#define UPLINK_STATUS_INVALID      2	/* value out of range        */
+#define UPLINK_STATUS_FLASH        3	/* set but not persisted     */
+
+/* runtime parameters, persisted in flash by the sink */
+#define PARAM_NODE_ID          0x01	/* 8-bit node id             */
+#define PARAM_REPORT_INTERVAL  0x02	/* timer ticks between sends */
+#define PARAM_RADIO_CHANNEL    0x03	/* CC2500 CHANNR             */
+#define PARAM_TX_POWER         0x04	/* CC2500 PATABLE setting    */
+#define PARAM_HANG             0x05	/* last hung task (swdog.h), */
+					/* count << 8, set 0 clears  */
+#define PARAM_DEADBAND         0x06	/* 1/10 oC, see report.h     */
+#define PARAM_HEARTBEAT        0x07	/* report intervals, >= 1    */
+#define PARAM_RX_DROPPED       0x08	/* radio packets lost to a   */
+					/* full queue, set 0 clears  */
+
+static inline uint16_t uplink_crc16_update(uint16_t crc, uint8_t data)
+{
+	/* byte-wise CRC-CCITT without table, cheap without a multiplier */
+	crc = (crc >> 8) | (crc << 8);
+	crc ^= data;
+	crc ^= (crc & 0xFF) >> 4;
+	crc ^= crc << 12;
+	crc ^= (crc & 0xFF) << 5;
+	return crc;
+}
+
+#define UPLINK_CRC16_INIT 0xFFFF
+
+/* firmware side: encodes and writes a frame with putchar */
+void uplink_send(uint8_t type, uint16_t timestamp,
+		 const uint8_t * payload, uint8_t length);
+void uplink_send_temperature(uint16_t timestamp, uint8_t node_id,
+			     int16_t temperature, int8_t rssi, uint8_t hops,
+			     uint8_t battery);
+void uplink_send_report_policy(uint16_t timestamp, uint8_t node_id,
+				uint16_t max_silence);
+void uplink_send_param(uint16_t timestamp, uint8_t param, uint8_t status,
+		       uint16_t value);
+void uplink_send_prof(uint16_t timestamp, uint8_t id, uint16_t smclk_khz,
+		      uint16_t count, uint16_t min, uint16_t max,
+		      uint32_t total);
+void uplink_send_sched(uint16_t timestamp, uint8_t id, uint16_t smclk_khz,
+		       uint16_t runs, uint16_t max, uint32_t total);
+void uplink_send_sched_lat(uint16_t timestamp, uint8_t id,
+			   const uint16_t * lat);
+/* firmware side: decodes in place a frame received up to (and without)
+ * its END delimiter, returns the frame length without the crc, 0 for an
+ * empty frame or -1 if the frame is corrupted */
+int uplink_unslip(uint8_t * frame, int length);
+
+#endif
@@ -0,0 +1,121 @@
+/**
+ *  \file   main.c
+ *  \brief  eZ430-RF2500 : fmt versus printf, cycles per call
+ **/
+
+#include <msp430f2274.h>
+
+#if defined(__GNUC__) && defined(__MSP430__)
+/* This is the MSPGCC compiler */
+#include <msp430.h>
+#include <iomacros.h>
+#include <legacymsp430.h>
+#elif defined(__IAR_SYSTEMS_ICC__)
+/* This is the IAR compiler */
+//#include <io430.h>
+#endif
+
+#include <stdio.h>
+
+#include "leds.h"
+#include "clock.h"
+#include "watchdog.h"
+#include "uart.h"
+#include "fmt.h"
+#include "lpm_compat.h"
+
+/* ************************************************** */
+/* ************************************************** */
+/* ************************************************** */
+
+/*
+ * Timer A runs from SMCLK = MCLK in continuous mode, so a TAR
+ * difference is a number of CPU cycles. Every formatted string fits in
+ * the uart tx ring, which is flushed before and after each measure: the
+ * numbers are formatting costs, not uart time.
+ */
+
+static unsigned int t_start;
+
+static void bench_start(void)
+{
+  uart_tx_flush();
+  t_start = TAR;
+}
+
+static void bench_stop(const char *name)
+{
+  unsigned int cycles = TAR - t_start;
+  uart_tx_flush();
+  fmt_str("  ");
+  fmt_str(name);
+  fmt_str(": ");
+  fmt_u16_dec(cycles);
+  fmt_str(" cycles\r\n");
+}
+
+static volatile int16_t temperature = -123;
+static volatile int8_t rssi = -60;
+static volatile uint8_t byte = 0xA5;
+
+int main(void)
+{
+  watchdog_stop();
+
+  set_mcu_speed_dco_mclk_16MHz_smclk_16MHz();
+  leds_init();
+  led_red_on();
+
+  uart_init_baudrate(9600);
+  TACTL = TASSEL_2 + MC_2;	// SMCLK, continuous mode
+
+  __enable_interrupt();
+
+  fmt_str("\r\nfmt benchmark\r\n");
+
+  bench_start();
+  fmt_u8_hex(byte);
+  bench_stop("fmt_u8_hex");
+
+  bench_start();
+  fmt_i16_dec(temperature);
+  bench_stop("fmt_i16_dec");
+
+  bench_start();
+  fmt_str("node_id,");
+  fmt_u16_dec(12);
+  fmt_str(",temperature,");
+  fmt_decicelsius(temperature);
+  fmt_str(",rssi,");
+  fmt_i16_dec(rssi);
+  fmt_str(",help,");
+  fmt_u16_dec(1);
+  fmt_eol();
+  bench_stop("fmt csv line");
+
+#if !defined(NO_PRINTF)
+  bench_start();
+  printf("%02X", byte);
+  bench_stop("printf %02X");
+
+  bench_start();
+  printf("%d", temperature);
+  bench_stop("printf %d");
+
+  bench_start();
+  printf("node_id,%d,temperature,%d.%d,rssi,%d,help,%d\r\n", 12,
+	 temperature / 10, temperature % 10, rssi, 1);
+  bench_stop("printf csv line");
+#endif
+
+  led_green_on();
+
+  for(;;)
+    {
+      LPM(4);
+    }
+}
+
+/* ************************************************** */
+/* ************************************************** */
+/* ************************************************** */
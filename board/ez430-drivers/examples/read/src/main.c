@@ -31,65 +31,18 @@
 /* ************************************************** */
 /* ************************************************** */
 
-#define SERIAL_RX_FIFO_SIZE 8
-
-volatile uint8_t serial_rx_buffer[SERIAL_RX_FIFO_SIZE];
-volatile uint8_t serial_rx_rptr;
-volatile uint8_t serial_rx_wptr;
-volatile uint8_t serial_rx_size;
-
-/* ************************************************** */
-
-void serial_ring_init()
-{
-  serial_rx_rptr = 0;
-  serial_rx_wptr = 0;
-  serial_rx_size = 0;
-}
-
-void serial_ring_put(uint8_t data)
-{
-  serial_rx_buffer[serial_rx_wptr] = data;
-  serial_rx_wptr = (serial_rx_wptr + 1) % SERIAL_RX_FIFO_SIZE;
-  if (serial_rx_size < SERIAL_RX_FIFO_SIZE)
-    {
-      serial_rx_size ++;
-    }
-  else
-    {
-      /* 
-       * if (serial_rx_size == SERIAL_RX_FIFO_SIZE) 
-       * we get a rx_overflow 
-      */
-    }
-}
-
-int serial_ring_get(uint8_t *data)
-{
-  if (serial_rx_size > 0)
-    {
-      *data = serial_rx_buffer[serial_rx_rptr];
-      serial_rx_rptr = (serial_rx_rptr + 1) % SERIAL_RX_FIFO_SIZE;
-      serial_rx_size --;
-      return 1;
-    }
-  return 0;
-}
+#define LINE_MAX 8
 
 /* ************************************************** */
 /* ************************************************** */
 /* ************************************************** */
 
-int serial_cb(unsigned char data)
-{
-  serial_ring_put(data);
-  return 1; /* will wakeup from LPMx */
-}
-
 int main(void)
 {
-  uint16_t addr = 0;
-  uint8_t  val, data;
+  uint16_t addr;
+  uint8_t  val;
+  unsigned char line[LINE_MAX];
+  int len, i;
 
   watchdog_stop();
   
@@ -98,8 +51,8 @@ int main(void)
   led_red_on();
   
   uart_init(UART_9600_SMCLK_8MHZ);
-  serial_ring_init();
-  uart_register_cb( serial_cb);
+  /* wakes up once per line instead of once per character */
+  uart_rx_start('\r');
   
   printf("serial read hex\n");
   led_green_on();
@@ -111,36 +64,31 @@ int main(void)
 
       LPM(1);
       
-      if (serial_ring_get(&data))
+      len = uart_rx_get_frame(line, LINE_MAX);
+      if (len >= 0)
 	{
-	  // echo
-	  printf("%c", data);
+	  led_green_switch();
 
-	  //
-	  if (data == '\r')
+	  //hex adress with 4 digit
+	  addr = 0;
+	  for (i = 0; i < len; i++)
 	    {
-	      led_green_switch();
+	      // echo
+	      printf("%c", line[i]);
 
-	      val  = *((uint8_t*)addr);
-	      printf("  [0x%04x] = 0x%02x\n",addr,val);
-	      addr = 0;
-	    }
-	  else
-	    {
-	      //hex adress with 4 digit
 	      addr <<= 4;
 
-	      if ((data >= '0') && (data <= '9'))
+	      if ((line[i] >= '0') && (line[i] <= '9'))
 		{
-		  addr += data - '0';
+		  addr += line[i] - '0';
 		}
-	      else if ((data >= 'a') && (data <= 'f'))
+	      else if ((line[i] >= 'a') && (line[i] <= 'f'))
 		{
-		  addr += data - 'a' + 10;
+		  addr += line[i] - 'a' + 10;
 		}
-	      else if ((data >= 'A') && (data <= 'F'))
+	      else if ((line[i] >= 'A') && (line[i] <= 'F'))
 		{
-		  addr += data - 'A' + 10;
+		  addr += line[i] - 'A' + 10;
 		}
 	      else
 		{
@@ -148,6 +96,9 @@ int main(void)
 		  addr = 0;
 		}
 	    }
+
+	  val  = *((uint8_t*)addr);
+	  printf("  [0x%04x] = 0x%02x\n",addr,val);
 	}
       else
 	{
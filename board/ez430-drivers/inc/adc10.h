@@ -14,7 +14,81 @@ void adc10_stop(void);
 
 void adc10_calibrate(uint16_t coeff1, uint16_t coeff2);
 
+/* conversions averaged by adc10_sample_temp, captured by the DTC in a
+ * single block (a power of 2, at most 64, ~77 us each) */
+#ifndef ADC10_TEMP_SAMPLES
+#define ADC10_TEMP_SAMPLES 16
+#endif
+
+/* returned by adc10_sample_temp and adc10_sample_avcc while the stream
+ * runs, out of range of both */
+#define ADC10_BUSY (-32767 - 1)
+/* returned by adc10_temp_decicelsius for a bad n */
+#define ADC10_INVALID (-32767)
+
+/* in 1/10 oC, or ADC10_BUSY */
 int adc10_sample_temp(void);
+/* converts the sum of n temperature sensor results, in 1/10 oC, n is a
+ * power of 2 (at most 64), else ADC10_INVALID is returned. Uses the
+ * factory calibration of information memory A when adc10_start finds
+ * it, else the nominal coefficients, until adc10_calibrate */
+int adc10_temp_decicelsius(uint16_t sum, uint8_t n);
+/* AVcc, in 1/10 V, valid from 2.2 V (1.5 V reference), or ADC10_BUSY */
 int adc10_sample_avcc(void);
+/* converts an AVcc/2 result (INCH_11) against 2.5 V, in 1/10 V, only
+ * valid for AVcc >= 2.9 V (2.5 V reference regulation) */
+int adc10_avcc_decivolts(uint16_t raw);
+
+/* ************************************************** */
+/* Channel scan                                       */
+/* ************************************************** */
+
+/*
+ * Converts once each channel from inch down to A0 (CONSEQ_1), e.g. from
+ * INCH_11: AVcc/2, the temperature sensor, then A9 ... A0. The reference
+ * is turned on and settled once for the whole sequence instead of once
+ * per channel, the DTC stores the results and the CPU is woken up once.
+ * results[i] is the raw result of channel inch - i, see
+ * ADC10_SCAN_RESULT. Every channel is converted against the 2.5 V
+ * reference, AVcc/2 would saturate 1.5 V: its result is only valid for
+ * AVcc >= 2.9 V, use adc10_sample_avcc otherwise. External inputs must be
+ * enabled in ADC10AE0 by the caller. Returns non 0, and converts
+ * nothing, while the stream runs.
+ */
+#define ADC10_SCAN_LEN(inch)               (((inch) >> 12) + 1)
+#define ADC10_SCAN_RESULT(results, inch, ch) ((results)[((inch) - (ch)) >> 12])
+
+int adc10_scan(uint16_t inch, uint16_t * results);
+/* converts the temperature sensor result (INCH_10) of a scan, in 1/10 oC */
+int adc10_scan_temp(uint16_t raw);
+
+/* ************************************************** */
+/* Continuous acquisition                             */
+/* ************************************************** */
+
+/*
+ * Conversions of channel inch (INCH_x, e.g. INCH_10 for the temperature
+ * sensor) are triggered by timer A OUT2 (SHS_3), and the DTC stores them
+ * in ring, two blocks of n results. The CPU is only interrupted when a
+ * block is full: cb is then called from the ADC10 interrupt with that
+ * block (valid until the other one is full), and returns non 0 to
+ * leave LPM on exit.
+ *
+ * Timer A belongs to the timer service (timer.h), which must be
+ * started, the rate is therefore one conversion per turn of TAR: 65536
+ * VLO ticks, ~5.5 s. The conversions need no CPU and keep working in
+ * LPM3. The reference stays on, its buffer only while sampling
+ * (REFBURST): ~0.25 mA for as long as the stream runs, more than the
+ * rest of the node in LPM3. Single conversions (adc10_sample_*,
+ * adc10_scan) return ADC10_BUSY or non 0 while the stream runs, call
+ * adc10_stream_stop first.
+ */
+
+typedef int (*adc10_stream_cb) (const uint16_t * block, uint8_t n);
+
+/* returns non 0 if the timer service is not started */
+int adc10_stream_start(uint16_t inch, uint16_t * ring, uint8_t n,
+		       adc10_stream_cb cb);
+void adc10_stream_stop(void);
 
 #endif
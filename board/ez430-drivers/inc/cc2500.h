@@ -110,6 +110,9 @@ void cc2500_rx_enter(void);	/* Start Rx mode */
 int cc2500_cca(void);		/* 0: busy, 1: clear */
 uint8_t cc2500_get_rssi(void);
 void cc2500_set_channel(uint8_t chan);
+/* PATABLE output power setting, 0xFE by default (0 dBm), see the
+ * CC2500 datasheet for the setting to dBm table */
+void cc2500_set_power(uint8_t patable);
 
 /************************************************/
 /*                                              */
@@ -8,12 +8,42 @@
 #ifndef MSP430_CLOCK_H
 #define MSP430_CLOCK_H
 
+#include <stdint.h>
+
 /* ************************************************** */
 /* Clock                                              */
 /* ************************************************** */
 
 int get_dco_mhz();
 int get_mclk_freq_mhz();
+/* SMCLK frequency in Hz, as set by the last set_mcu_speed_* call */
+unsigned long get_smclk_freq_hz();
+
+/* ************************************************** */
+/* Clock manager                                      */
+/* ************************************************** */
+
+/*
+ * The DCO and SMCLK may change at runtime, e.g. 1 MHz while idle and
+ * 16 MHz for radio bursts. Drivers deriving settings from SMCLK (uart,
+ * spi) register a hook: it is called with CLOCK_CHANGE_PRE and the new
+ * SMCLK frequency before the change (to finish a transfer), then with
+ * CLOCK_CHANGE_POST after it, interrupts disabled, to recompute their
+ * dividers. Flash timing and delays are derived at each use.
+ */
+
+#define CLOCK_CHANGE_PRE  0
+#define CLOCK_CHANGE_POST 1
+#define CLOCK_MAX_CHANGE_CB 4
+
+typedef void (*clock_change_cb) (int phase, unsigned long smclk_hz);
+
+/* returns non 0 if CLOCK_MAX_CHANGE_CB hooks are already registered,
+ * registering a hook twice has no effect */
+int clock_register_change_cb(clock_change_cb cb);
+/* dco_mhz is 1, 8, 12 or 16 (calibrated DCO), smclk_divider is 1, 2,
+ * 4 or 8, returns non 0 for other values */
+int clock_set_speed(unsigned char dco_mhz, unsigned char smclk_divider);
 
 void set_mcu_speed_dco_mclk_1MHz_smclk_1MHz();
 
@@ -32,9 +62,56 @@ void set_mcu_speed_dco_mclk_16MHz_smclk_8MHz();
 void set_mcu_speed_dco_mclk_16MHz_smclk_4MHz();
 void set_mcu_speed_dco_mclk_16MHz_smclk_2MHz();
 
+/* ACLK runs from VLO, nominally 12 kHz but anywhere from 4 to 20 kHz
+ * depending on the part and temperature */
+#define VLO_FREQ_NOMINAL 12000
+
+/* measures VLO against SMCLK (factory calibrated DCO) with a timer B
+ * capture of ACLK and busy waits a few VLO periods. Timer B is left as
+ * it was if it ran from SMCLK in continuous mode, any other use of it
+ * is disturbed. Returns the VLO frequency in Hz, or 0 if the measure
+ * failed and the previous value is kept. Call it at boot and again from
+ * time to time, as VLO drifts with temperature. */
+unsigned int clock_calibrate_vlo(void);
+/* last measured (or nominal) VLO frequency in Hz */
+unsigned int get_vlo_freq_hz(void);
+/* milliseconds to VLO ticks with the measured frequency */
+unsigned long clock_vlo_ms_to_ticks(unsigned long ms);
+
+/* ************************************************** */
+/* Monotonic clock                                    */
+/* ************************************************** */
+
+/*
+ * Free running time base, the timer service (timer_service_init in
+ * timer.h) must be started. Both are safe to call from interrupts and
+ * with interrupts disabled. Compare times by difference, the tick
+ * count wraps after ~4 days at 12 kHz and the ms count after ~49 days.
+ */
+
+/* VLO ticks since timer_service_init, TAR extended to 32 bits */
+uint32_t clock_now_ticks32(void);
+/* milliseconds since timer_service_init, from the measured VLO
+ * frequency; recalibrating never makes it go backwards */
+uint32_t clock_now_ms(void);
+
 /* delay_ms and delay_usec are blocking,
 a timer should be used instead in most cases */
 
+/*
+ * With interrupts enabled, delays sleep: delay_usec in LPM0 on a timer
+ * B compare (SMCLK, continuous mode, see clock_calibrate_vlo) unless
+ * the delay is too short to pay for the wake up, delay_ms in LPM3 on a
+ * timer service event (LPM0 on timer B if the service is not started).
+ * Other interrupts may wake the CPU, it goes back to sleep until the
+ * delay is over. With interrupts disabled, delays spin.
+ */
+
+/* returns non 0 while a peripheral needs SMCLK, e.g. uart_tx_pending */
+typedef unsigned int (*clock_busy_cb) (void);
+/* delay_ms sleeps in LPM0 instead of LPM3 while cb returns non 0 */
+void clock_register_smclk_busy_cb(clock_busy_cb cb);
+
 /* blocks at least usec microseconds (consider using a timer instead) */
 void delay_usec(unsigned int usec);
 /* blocks at least ms milliseconds (consider using a timer instead) */
@@ -0,0 +1,33 @@
+/**
+ *  \file   fmt.h
+ *  \brief  eZ430-RF2500, printf-free integer formatting on the uart
+ **/
+
+#ifndef FMT_H
+#define FMT_H
+
+#include <stdint.h>
+
+/*
+ * Fixed function replacements for the few printf conversions used on
+ * the node. Characters are queued in the uart tx ring (putchar), no
+ * stdio, no division: decimal digits are produced by subtracting
+ * powers of ten, which is cheap without a hardware multiplier.
+ */
+
+/* "AB" */
+void fmt_u8_hex(uint8_t value);
+/* "ABCD" */
+void fmt_u16_hex(uint16_t value);
+/* "1234", no padding */
+void fmt_u16_dec(uint16_t value);
+/* "-1234", no padding */
+void fmt_i16_dec(int16_t value);
+/* temperature in tenths of degree: -123 is "-12.3" */
+void fmt_decicelsius(int16_t value);
+/* raw string, without trailing new line */
+void fmt_str(const char *str);
+/* "\r\n" */
+void fmt_eol(void);
+
+#endif
@@ -2,10 +2,13 @@
 /* This is the MSPGCC compiler */
 #include <iomacros.h>
 #define SFRB(varname, address) sfrb(varname, address)
+/* variables left alone by the startup code, they survive a reset */
+#define NOINIT __attribute__ ((section(".noinit")))
 #include <msp430.h>
 #elif defined(__IAR_SYSTEMS_ICC__)
 /* This is the IAR compiler */
 #include <intrinsics.h>
 #define SFRB(varname, address) __no_init volatile unsigned char varname @ address
+#define NOINIT __no_init
 #define BV(x) (1 << (x))
 #endif
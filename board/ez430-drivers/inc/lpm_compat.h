@@ -2,10 +2,16 @@
 /* This is the MSPGCC compiler */
 //#include <msp430/common.h>
 #define LPM(n) LPM ## n
+#define LPM_GIE(n) _BIS_SR(LPM ## n ## _bits | GIE)
 #define LPM_OFF_ON_EXIT LPM4_EXIT
 #elif defined(__IAR_SYSTEMS_ICC__)
 /* This is the IAR compiler */
 #include <intrinsics.h>
 #define LPM(n) __low_power_mode_ ## n ## ()
+#define LPM_GIE(n) __bis_SR_register(LPM ## n ## _bits | GIE)
 #define LPM_OFF_ON_EXIT __low_power_mode_off_on_exit()
 #endif
+
+/* LPM_GIE(n) enables interrupts and enters LPMn with a single
+ * instruction: a wake up condition checked with interrupts disabled
+ * cannot be missed before going to sleep */
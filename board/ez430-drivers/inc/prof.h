@@ -0,0 +1,65 @@
+/**
+ *  \file   prof.h
+ *  \brief  cycle profiling probes on timer B
+ **/
+
+#ifndef PROF_H
+#define PROF_H
+
+#include <stdint.h>
+
+/* ************************************************** */
+/* Profiling                                          */
+/* ************************************************** */
+
+/*
+ * Timer B runs from SMCLK in continuous mode as a cycle counter (the
+ * VLO calibration and sleeping delays leave it running). Probes are
+ * compiled in with -DPROFILING only (make PROFILING=1, for the drivers
+ * and for the application), otherwise PROF_BEGIN and PROF_END are
+ * empty. The TBR register must be visible where they are used.
+ *
+ * A probe measures SMCLK cycles between PROF_BEGIN(id) and PROF_END(id),
+ * interrupts included. A single measure must stay below 65536 cycles,
+ * 8 ms at 8 MHz. The begin timestamp is kept in the table, so that a
+ * probe may span protothread yields, but a probe must not be nested in
+ * itself (e.g. used by an ISR and by the code it interrupts).
+ */
+
+/* probes of the drivers, applications start at PROF_FIRST_USER */
+#define PROF_CC2500_RX_EOP   0
+#define PROF_ADC10_TEMP      1
+#define PROF_ADC10_SCAN      2
+#define PROF_FIRST_USER      3
+
+#ifndef PROF_MAX_PROBES
+#define PROF_MAX_PROBES 8
+#endif
+
+struct prof_probe {
+	uint16_t start;
+	uint16_t count;		/* saturates at 0xFFFF */
+	uint16_t min;
+	uint16_t max;
+	uint32_t total;
+};
+
+extern struct prof_probe prof_table[PROF_MAX_PROBES];
+
+/* starts timer B and clears the table */
+void prof_init(void);
+void prof_reset(void);
+void prof_end(uint8_t id, uint16_t now);
+/* prints "prof,<id>,count,<n>,min,<c>,max,<c>,total,<hex>" lines for
+ * the probes that were hit, cycles are SMCLK cycles */
+void prof_dump(void);
+
+#if defined(PROFILING)
+#define PROF_BEGIN(id) do { prof_table[id].start = TBR; } while (0)
+#define PROF_END(id)   prof_end(id, TBR)
+#else
+#define PROF_BEGIN(id) do { } while (0)
+#define PROF_END(id)   do { } while (0)
+#endif
+
+#endif
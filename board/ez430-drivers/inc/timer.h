@@ -8,13 +8,16 @@
 #ifndef MSP430_TIMER_H
 #define MSP430_TIMER_H
 
+#include <stdint.h>
+
 /* ************************************************** */
 /*                                                    */
 /* ************************************************** */
 
 typedef void (*timer_cb) (void);
 
-/* timer A is set on VLO at 12 kHz */
+/* timer A is set on VLO at ~12 kHz, milliseconds are converted with
+ * the frequency measured by clock_calibrate_vlo (clock.h) */
 void timerA_init(void);
 void timerA_register_cb(timer_cb);
 void timerA_set_wakeup(int);
@@ -22,7 +25,54 @@ void timerA_start_ticks(unsigned int ticks);
 void timerA_start_milliseconds(unsigned int ms);
 void timerA_stop(void);
 
-/* timer B is set on VLO at 12kHz */
+/* ************************************************** */
+/* Timer service                                      */
+/* ************************************************** */
+
+/*
+ * Tickless software timers on timer A. Timer A runs continuously from
+ * VLO and TACCR1 is only programmed for the nearest deadline, so that
+ * the CPU wakes up when a timer is due (plus one overflow interrupt
+ * every 65536 ticks to extend TAR to 32 bits). The service owns timer
+ * A: do not mix it with timerA_start_ticks/milliseconds.
+ *
+ * Events are allocated by the caller and kept in a list sorted by
+ * deadline. On expiry `fired` is set, then the callback, if any, is
+ * called from the ISR: it returns non 0 to leave LPM on exit. Events
+ * without callback always leave LPM, a protothread waits for them with
+ * PT_WAIT_UNTIL(pt, timer_event_expired(&ev)).
+ */
+
+struct timer_event;
+typedef int (*timer_event_cb) (struct timer_event *);
+
+struct timer_event {
+	struct timer_event *next;
+	uint32_t deadline;	/* in ticks */
+	uint32_t period;	/* in ticks, 0 for one-shot */
+	timer_event_cb cb;
+	volatile uint8_t fired;
+	uint8_t active;
+};
+
+void timer_service_init(void);
+/* returns non 0 once timer_service_init was called */
+int timer_service_started(void);
+/* current time, in ticks */
+uint32_t timer_service_now(void);
+uint32_t timer_ms_to_ticks(uint32_t ms);
+
+/* (re)starts ev to expire in delay ticks, then every period ticks if
+ * period is not 0. Can be called from an ISR or an event callback. */
+void timer_event_start(struct timer_event *ev, uint32_t delay,
+		       uint32_t period, timer_event_cb cb);
+void timer_event_stop(struct timer_event *ev);
+/* returns non 0 while ev is started and has not expired (one-shot) */
+int timer_event_pending(struct timer_event *ev);
+/* returns non 0 if ev fired since the last call */
+int timer_event_expired(struct timer_event *ev);
+
+/* timer B is set on VLO at ~12 kHz */
 void timerB_init(void);
 void timerB_register_cb(timer_cb);
 void timerB_set_wakeup(int);
@@ -0,0 +1,67 @@
+/**
+ *  \file   twheel.h
+ *  \brief  hierarchical timing wheel for many concurrent timeouts
+ **/
+
+#ifndef TWHEEL_H
+#define TWHEEL_H
+
+#include <stdint.h>
+
+/* ************************************************** */
+/* Timing wheel                                       */
+/* ************************************************** */
+
+/*
+ * Timeouts are counted in wheel ticks of TWHEEL_TICK_MS. Starting and
+ * stopping a timer is O(1): a timer is hashed into a slot of one of
+ * TWHEEL_LEVELS wheels of 2^TWHEEL_BITS slots according to how far its
+ * expiry is, and slots of the upper levels are cascaded down when the
+ * lower level wraps. Storage is the caller's struct twheel_timer, the
+ * wheel itself only holds 2^TWHEEL_BITS * TWHEEL_LEVELS list heads.
+ *
+ * On the msp430 the wheel ticks from a periodic event of the timer
+ * service (timer.h), which is only running while a timer is pending.
+ * Callbacks are called from the timer A interrupt and return non 0 to
+ * leave LPM, a timer without callback always leaves LPM.
+ */
+
+#ifndef TWHEEL_BITS
+#define TWHEEL_BITS 4
+#endif
+#ifndef TWHEEL_LEVELS
+#define TWHEEL_LEVELS 3
+#endif
+#ifndef TWHEEL_TICK_MS
+#define TWHEEL_TICK_MS 10
+#endif
+
+#define TWHEEL_SLOTS (1 << TWHEEL_BITS)
+/* longest timeout, longer ones are clamped (at most 32767) */
+#define TWHEEL_MAX_TICKS ((1UL << (TWHEEL_BITS * TWHEEL_LEVELS)) - 1)
+
+struct twheel_timer;
+typedef int (*twheel_cb) (struct twheel_timer *);
+
+struct twheel_timer {
+	struct twheel_timer *next;
+	struct twheel_timer **pprev;	/* NULL when not pending */
+	uint16_t expires;
+	twheel_cb cb;
+};
+
+void twheel_init(void);
+/* (re)starts t to expire in ticks wheel ticks (at least 1) */
+void twheel_start(struct twheel_timer *t, uint16_t ticks, twheel_cb cb);
+void twheel_stop(struct twheel_timer *t);
+/* returns non 0 while t is started and has not expired */
+int twheel_pending(struct twheel_timer *t);
+/* number of pending timers */
+unsigned int twheel_count(void);
+
+/* advances the wheel by one tick and runs the expired timers, returns
+ * non 0 if a callback asked to leave LPM. Called by the timer service
+ * on the msp430, exported for host tests. */
+int twheel_tick(void);
+
+#endif
@@ -18,11 +18,74 @@
 typedef int (*uart_cb_t) (unsigned char data);
 
 void uart_init(int config);
+
+/* configures the uart for any baud rate from the current SMCLK
+ * (see get_smclk_freq_hz), returns non 0 if the rate cannot be
+ * generated, in which case the uart is left untouched */
+int uart_init_baudrate(unsigned long baudrate);
+/* effective baud rate generated by the last uart_init_baudrate */
+unsigned long uart_get_baudrate(void);
+/* relative baud rate error of the last uart_init_baudrate,
+ * in tenths of percent (+12 means 1.2% too fast) */
+int uart_get_baud_error(void);
+
 void uart_stop(void);
 void uart_register_cb(uart_cb_t);
 
+/* ************************************************** */
+/* Rx ring buffer                                     */
+/* ************************************************** */
+
+/* must be a power of 2, at most 128, and hold the longest frame with
+ * its delimiter (64: a SLIP escaped demo uplink frame takes 42) */
+#ifndef UART_RX_RING_SIZE
+#define UART_RX_RING_SIZE 64
+#endif
+
+#define UART_RX_NO_DELIMITER (-1)
+
+/* buffers received bytes in the driver instead of calling a callback
+ * (any registered callback is dropped). With UART_RX_NO_DELIMITER the
+ * rx interrupt leaves LPM on each byte, otherwise only once a complete
+ * frame ending with `delimiter` (e.g. '\r') has been received. A frame
+ * that does not fit in the ring is dropped, and reception resumes
+ * after the next delimiter */
+void uart_rx_start(int delimiter);
+/* number of buffered bytes */
+unsigned int uart_rx_available(void);
+/* pops one byte, returns 0 if the ring is empty */
+int uart_rx_get(unsigned char *data);
+/* number of complete frames buffered */
+unsigned int uart_rx_frames(void);
+/* pops one frame without its delimiter, at most length bytes are
+ * copied, returns the frame length or -1 if no frame is complete */
+int uart_rx_get_frame(unsigned char *buffer, int length);
+/* bytes dropped because the ring was full, frames dropped because
+ * they did not fit */
+unsigned int uart_rx_overruns(void);
+/* bytes dropped on framing, parity or overrun errors */
+unsigned int uart_rx_errors(void);
+/* cb is called from the rx interrupt each time it leaves LPM (byte or
+ * frame received), e.g. to make a thread runnable */
+void uart_rx_register_notify(void (*cb) (void));
+
+/* ************************************************** */
+/* Tx ring buffer                                     */
+/* ************************************************** */
+
+/* must be a power of 2, at most 128 */
+#ifndef UART_TX_RING_SIZE
+#define UART_TX_RING_SIZE 64
+#endif
+
+/* queues c for transmission, only blocks when the ring is full */
 int putchar(int);
 int getchar(void);
+/* number of bytes waiting for transmission */
+unsigned int uart_tx_pending(void);
+/* blocks until every queued byte has been sent (e.g. before a reset
+ * or before stopping SMCLK in LPM3 and above) */
+void uart_tx_flush(void);
 
 /* ************************************************** */
 /*                                                    */
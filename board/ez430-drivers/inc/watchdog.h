@@ -1,9 +1,45 @@
 #ifndef MSP430_WATCHDOG_H
 #define MSP430_WATCHDOG_H
 
+#include <stdint.h>
+
 /* save watchdog configuration and stop it */
 void watchdog_stop();
 /* restore the last saved watchdog configuration */
 void watchdog_restore();
 
+/* ************************************************** */
+/* Interval timer                                     */
+/* ************************************************** */
+
+/*
+ * The WDT+ as an interval timer on ACLK/VLO, a coarse system tick that
+ * keeps running in LPM3 and leaves timers A and B free. The interval is
+ * a number of VLO periods (~12 kHz, see clock_calibrate_vlo):
+ *   WATCHDOG_INTERVAL_64     ~5.3 ms
+ *   WATCHDOG_INTERVAL_512    ~43 ms
+ *   WATCHDOG_INTERVAL_8192   ~683 ms
+ *   WATCHDOG_INTERVAL_32768  ~2.7 s
+ * The watchdog does not reset the MCU in this mode. watchdog_stop and
+ * watchdog_restore pause and resume the tick.
+ */
+
+#define WATCHDOG_INTERVAL_32768 0
+#define WATCHDOG_INTERVAL_8192  1
+#define WATCHDOG_INTERVAL_512   2
+#define WATCHDOG_INTERVAL_64    3
+
+typedef void (*watchdog_cb) (void);
+
+void watchdog_interval_start(int interval);
+void watchdog_interval_stop(void);
+/* called from the WDT interrupt on each tick */
+void watchdog_interval_register_cb(watchdog_cb cb);
+/* leave LPM on each tick if w is 1 */
+void watchdog_interval_set_wakeup(int w);
+/* ticks since watchdog_interval_start */
+uint32_t watchdog_interval_ticks(void);
+/* tick period in ms, from the measured VLO frequency */
+unsigned int watchdog_interval_period_ms(void);
+
 #endif
@@ -22,12 +22,93 @@
 #include "io_compat.h"
 #include "lpm_compat.h"
 #include "clock.h"
+#include "timer.h"
+#include "prof.h"
 #include "adc10.h"
 #include "flash.h"
 
 
-static volatile int coeff_1;
-static volatile int coeff_2;
+static int coeff_1;
+static int coeff_2;
+
+/*
+ * Temperatures are computed in fixed point:
+ *   1/10 oC = (A10 * slope - offset) >> ADC10_TEMP_Q
+ * a single 16x16 bits multiply, no division. One slope and offset per
+ * reference: 1.5 V for adc10_sample_temp, 2.5 V for a scan.
+ */
+#define ADC10_TEMP_Q 12
+#define ADC10_REF_1V5 0
+#define ADC10_REF_2V5 1
+static uint16_t adc10_temp_slope[2];
+static int32_t adc10_temp_offset[2];
+
+/* nominal coefficients, from the data sheet
+ * oC = ((A10/1024)*1500mV)-986mV)*1/3.55mV = A10*423/1024 - 278
+ * the temperature is transmitted as an integer where 32.1 = 321
+ * hence 4230 instead of 423 */
+#define ADC10_COEFF_1 4230
+#define ADC10_COEFF_2 2780
+
+#if ADC10_TEMP_SAMPLES > 64 || (ADC10_TEMP_SAMPLES & (ADC10_TEMP_SAMPLES - 1))
+#error "ADC10_TEMP_SAMPLES must be a power of 2, at most 64"
+#endif
+
+/* factory calibration, information segment A (SLAU144 24.2) */
+#define TLV_CHECKSUM   0x10C0
+#define TLV_START      0x10C2
+#define TLV_END        0x1100
+#define TAG_ADC10_1    0x10
+#define TLV_ADC10_LEN  16
+/* words of the TAG_ADC10_1 data, results at 30 and 85 oC with the
+ * 1.5 V and 2.5 V references */
+#define CAL_ADC_15T30  3
+#define CAL_ADC_15T85  4
+#define CAL_ADC_25T30  6
+#define CAL_ADC_25T85  7
+
+/* returns the data of the first tag entry of a valid TLV, or NULL */
+static const uint16_t *adc10_tlv_find(uint8_t tag, uint8_t len)
+{
+	const uint16_t *w;
+	const uint8_t *p;
+	uint16_t check = 0;
+
+	for (w = (const uint16_t *)TLV_START; w < (const uint16_t *)TLV_END;
+	     w++)
+		check ^= *w;
+	if ((uint16_t) (check + *(const uint16_t *)TLV_CHECKSUM) != 0)
+		return NULL;
+
+	p = (const uint8_t *)TLV_START;
+	while (p + 2 <= (const uint8_t *)TLV_END && p[1] != 0xFF) {
+		if (p[0] == tag && p[1] >= len)
+			return (const uint16_t *)(p + 2);
+		p += 2 + p[1];
+	}
+	return NULL;
+}
+
+static void adc10_set_coeffs(void)
+{
+	adc10_temp_slope[ADC10_REF_1V5] = coeff_1 << (ADC10_TEMP_Q - 10);
+	adc10_temp_slope[ADC10_REF_2V5] =
+	    ((uint32_t) coeff_1 << (ADC10_TEMP_Q - 10)) * 5 / 3;
+	adc10_temp_offset[ADC10_REF_1V5] = (int32_t) coeff_2 << ADC10_TEMP_Q;
+	adc10_temp_offset[ADC10_REF_2V5] = (int32_t) coeff_2 << ADC10_TEMP_Q;
+}
+
+/* two points: 300 at t30, 850 at t85, the only division */
+static void adc10_set_cal(uint8_t ref, uint16_t t30, uint16_t t85)
+{
+	/* ~155 (1.5 V) or ~80 (2.5 V) counts apart, a slope that does not
+	 * fit 16 bits is junk */
+	if (t85 > 0x3FF || t85 < t30 + 40)
+		return;
+	adc10_temp_slope[ref] = (550UL << ADC10_TEMP_Q) / (t85 - t30);
+	adc10_temp_offset[ref] = (int32_t) t30 * adc10_temp_slope[ref]
+	    - (300L << ADC10_TEMP_Q);
+}
 
 /* **************************************************
  * 
@@ -35,8 +116,16 @@ static volatile int coeff_2;
 
 void adc10_start(void)
 {
-		coeff_1 = 4230;
-		coeff_2 = 2780;
+	const uint16_t *cal = adc10_tlv_find(TAG_ADC10_1, TLV_ADC10_LEN);
+
+	coeff_1 = ADC10_COEFF_1;
+	coeff_2 = ADC10_COEFF_2;
+	adc10_set_coeffs();
+
+	if (cal == NULL)
+		return;
+	adc10_set_cal(ADC10_REF_1V5, cal[CAL_ADC_15T30], cal[CAL_ADC_15T85]);
+	adc10_set_cal(ADC10_REF_2V5, cal[CAL_ADC_25T30], cal[CAL_ADC_25T85]);
 }
 
 void adc10_calibrate(uint16_t coeff1, uint16_t coeff2) {
@@ -46,6 +135,7 @@ void adc10_calibrate(uint16_t coeff1, uint16_t coeff2) {
 	if (coeff2 !=0){
 		coeff_2 = coeff2;
 	}
+	adc10_set_coeffs();
 }
 
 
@@ -63,68 +153,230 @@ void adc10_stop(void)
  * 
  * **************************************************/
 
+static volatile uint8_t adc10_done;
+static volatile adc10_stream_cb adc10_stream;
+static uint16_t *adc10_stream_ring;
+static uint8_t adc10_stream_n;
+
 ISR(ADC10, adc10irq)
 {
-	LPM_OFF_ON_EXIT;
+	int wakeup = 1;
+
+	if (adc10_stream != NULL) {
+		/* ADC10B1 is set when the DTC has just filled block 1 */
+		wakeup = adc10_stream((ADC10DTC0 & ADC10B1) ?
+				      adc10_stream_ring :
+				      adc10_stream_ring + adc10_stream_n,
+				      adc10_stream_n);
+	} else {
+		adc10_done = 1;
+	}
+
+	if (wakeup)
+		LPM_OFF_ON_EXIT;
 }
 
-#define TEMPOFFSET_ 0x10F4
-SFRB(TEMPOFFSET, TEMPOFFSET_);
+/* reference buffer settling time, tREFON in the data sheet (the former
+ * 240 cycles were only long enough up to 8 MHz) */
+#define ADC10_REF_SETTLE_USEC 30
 
-int adc10_sample_temp(void)
+/*
+ * Converts n times the channel selected by ctl1, or once each channel of
+ * a sequence if ctl1 has CONSEQ_1, and returns the sum of the results.
+ * The DTC moves every result to buf, the CPU sleeps in LPM0 until the
+ * end of the block: one wake-up whatever n. ADC10OSC keeps running in
+ * LPM0 and the reference is turned off on return. Returns non 0 while
+ * the stream runs: it owns the ADC10 and its interrupt, the block would
+ * never end.
+ */
+static int adc10_sample_block(uint16_t ctl0, uint16_t ctl1,
+			      uint16_t * buf, uint8_t n, uint16_t * sum)
 {
-	volatile long result;
-	int degC;
+	unsigned int state;
+	uint8_t i;
 
-	ADC10CTL1 = INCH_10 + ADC10DIV_4;	// Temp Sensor ADC10CLK/3
-	ADC10CTL0 = SREF_1 + ADC10SHT_3 + REFON + ADC10ON + ADC10IE + ADC10SR;
-	loop_4_cycles(60);	// delay to allow reference to settle (240 cycles)
-	ADC10CTL0 |= ENC + ADC10SC;	// Sampling and conversion start
+	if (adc10_stream != NULL)
+		return -1;
 
-	LPM(0);
+	if (n > 1 && (ctl1 & CONSEQ_3) == 0)
+		ctl1 |= CONSEQ_2;	// repeat single channel
+	ADC10CTL1 = ctl1;
+	ADC10CTL0 = ctl0 | (n > 1 ? MSC : 0) | REFON | ADC10ON | ADC10IE;
+	ADC10DTC0 = 0;		// one block, then stop
+	ADC10DTC1 = n;
+	ADC10SA = (unsigned int)buf;	// arms the DTC
+	delay_usec(ADC10_REF_SETTLE_USEC);	// delay to allow reference to settle
+
+	state = __get_interrupt_state();
+	__disable_interrupt();
+	adc10_done = 0;
+	ADC10CTL0 |= ENC + ADC10SC;	// Sampling and conversion start
+	/* other interrupts may leave LPM before the end of the block */
+	while (!adc10_done) {
+		LPM_GIE(0);
+		__disable_interrupt();
+	}
+	__set_interrupt_state(state);
 
-	result = ADC10MEM;
 	ADC10CTL0 &= ~ENC;
 	ADC10CTL0 &= ~(REFON + ADC10ON);	// turn off A/D to save power
+	ADC10DTC1 = 0;		// DTC off
+
+	*sum = 0;
+	for (i = 0; i < n; i++)
+		*sum += buf[i];
+	return 0;
+}
+
+static int adc10_temp_convert(uint8_t ref, uint16_t sum, uint8_t n)
+{
+	uint8_t shift = ADC10_TEMP_Q;
+	uint32_t offset = adc10_temp_offset[ref];
+	int32_t t;
 
-	// oC = ((A10/1024)*1500mV)-986mV)*1/3.55mV = A10*423/1024 - 278
-	// the temperature is transmitted as an integer where 32.1 = 321
-	// hence 4230 instead of 423
-	// VTEMP=0.00355(TEMPC)+0.986
+	/* 64 results of 1023 still fit the sum */
+	if (n == 0 || n > 64 || (n & (n - 1)))
+		return ADC10_INVALID;
 
-	degC = ((result * coeff_1) / 1024) - coeff_2;
+	/* n is a power of 2, the average is a shift folded in the final
+	 * one, which keeps the extra resolution of the sum */
+	for (; n > 1; n >>= 1) {
+		offset <<= 1;
+		shift++;
+	}
+	/* the product may not fit a signed long, the difference does */
+	t = (int32_t) ((uint32_t) sum * adc10_temp_slope[ref] - offset);
+	/* rounded to the nearest 1/10 oC */
+	return (t + (1L << (shift - 1))) >> shift;
+}
 
-	/*
-	   if( TEMPOFFSET != 0xFFFF )
-	   degC += TEMPOFFSET; 
-	 */
+int adc10_temp_decicelsius(uint16_t sum, uint8_t n)
+{
+	return adc10_temp_convert(ADC10_REF_1V5, sum, n);
+}
+
+int adc10_sample_temp(void)
+{
+	uint16_t buf[ADC10_TEMP_SAMPLES];
+	uint16_t result;
+	int degC = ADC10_BUSY;
+
+	PROF_BEGIN(PROF_ADC10_TEMP);
+
+	// Temp Sensor ADC10CLK/5
+	if (adc10_sample_block(SREF_1 + ADC10SHT_3 + ADC10SR,
+			       INCH_10 + ADC10DIV_4, buf, ADC10_TEMP_SAMPLES,
+			       &result) == 0)
+		degC = adc10_temp_decicelsius(result, ADC10_TEMP_SAMPLES);
+
+	PROF_END(PROF_ADC10_TEMP);
 	return degC;
 }
 
+/* **************************************************
+ * Continuous acquisition
+ * **************************************************/
+
+int adc10_stream_start(uint16_t inch, uint16_t * ring, uint8_t n,
+		       adc10_stream_cb cb)
+{
+	if (!timer_service_started() || n == 0 || cb == NULL)
+		return -1;
+
+	adc10_stream_stop();
+	adc10_stream_ring = ring;
+	adc10_stream_n = n;
+	adc10_stream = cb;
+
+	/* OUT2 is set at TACCR2 and reset at TACCR0, half a turn later:
+	 * one rising edge, hence one conversion, per TAR turn */
+	TACCTL0 = 0;
+	TACCR0 = 0;
+	TACCR2 = 0x8000;
+	TACCTL2 = OUTMOD_3;
+
+	// one conversion per OUT2 rising edge, reference buffer only on
+	// while sampling
+	ADC10CTL1 = inch + SHS_3 + ADC10DIV_4 + CONSEQ_2;
+	ADC10CTL0 = SREF_1 + ADC10SHT_3 + ADC10SR + REFBURST + REFON +
+	    ADC10ON + ADC10IE;
+	ADC10DTC0 = ADC10TB | ADC10CT;	// two blocks, continuous
+	ADC10DTC1 = n;
+	ADC10SA = (unsigned int)ring;	// arms the DTC
+	ADC10CTL0 |= ENC;
+	return 0;
+}
+
+void adc10_stream_stop(void)
+{
+	if (adc10_stream == NULL)
+		return;
+
+	ADC10CTL0 &= ~ENC;
+	ADC10CTL0 &= ~(REFON + ADC10ON + ADC10IE);
+	ADC10DTC0 = 0;
+	ADC10DTC1 = 0;
+	TACCTL2 = 0;
+	adc10_stream = NULL;
+}
+
 /* **************************************************
  * 
  * **************************************************/
 
+int adc10_avcc_decivolts(uint16_t raw)
+{
+	// AVcc/2 against 2.5 V
+	return (raw * 25u) / 512;
+}
+
+/*
+ * The 2.5 V reference needs AVcc >= 2.9 V, below it reads ~2.5 V
+ * whatever the supply: AVcc/2 is converted against 1.5 V, valid up to
+ * AVcc = 3 V, and only a saturated result is converted again against
+ * 2.5 V.
+ */
 int adc10_sample_avcc(void)
 {
-	volatile long result;
-	unsigned int volt;
+	uint16_t buf[1];
+	uint16_t raw;
 
-	ADC10CTL1 = INCH_11;	// AVcc/2
-	ADC10CTL0 = SREF_1 + ADC10SHT_2 + REFON + ADC10ON + ADC10IE + REF2_5V;
+	// AVcc/2
+	if (adc10_sample_block(SREF_1 + ADC10SHT_2, INCH_11, buf, 1, &raw))
+		return ADC10_BUSY;
+	if (raw < 0x3FF)
+		return (raw * 15u) / 512;
+	adc10_sample_block(SREF_1 + ADC10SHT_2 + REF2_5V, INCH_11, buf, 1,
+			   &raw);
+	return adc10_avcc_decivolts(raw);
+}
 
-	loop_4_cycles(60);	// delay to allow reference to settle (240 cycles)
+/* **************************************************
+ * Channel scan
+ * **************************************************/
 
-	ADC10CTL0 |= ENC + ADC10SC;	// Sampling and conversion start
+int adc10_scan(uint16_t inch, uint16_t * results)
+{
+	uint16_t sum;
+	int ret;
 
-	LPM(0);
+	PROF_BEGIN(PROF_ADC10_SCAN);
 
-	result = ADC10MEM;
-	ADC10CTL0 &= ~ENC;
-	ADC10CTL0 &= ~(REFON + ADC10ON);	// turn off A/D to save power
+	/* 64 ADC10CLK of sampling at ADC10OSC/3 are still the 30 us the
+	 * temperature sensor needs with the fastest oscillator, and a
+	 * shorter conversion than adc10_sample_temp for the other
+	 * channels */
+	ret = adc10_sample_block(SREF_1 + ADC10SHT_3 + ADC10SR + REF2_5V,
+				 inch + ADC10DIV_2 + CONSEQ_1, results,
+				 ADC10_SCAN_LEN(inch), &sum);
+
+	PROF_END(PROF_ADC10_SCAN);
+	return ret;
+}
 
-	volt = (result * 25) / 512;
-	return volt;
+int adc10_scan_temp(uint16_t raw)
+{
+	return adc10_temp_convert(ADC10_REF_2V5, raw, 1);
 }
 
 /* **************************************************
@@ -20,6 +20,7 @@
 #include "leds.h"
 #include "spi.h"
 #include "clock.h"
+#include "prof.h"
 #include "cc2500.h"
 
 /**************************************/
@@ -664,6 +665,11 @@ void cc2500_set_channel(uint8_t chan)
 	CC2500_SPI_WREG(CC2500_REG_CHANNR, chan);
 }
 
+void cc2500_set_power(uint8_t patable)
+{
+	CC2500_SPI_WREG(CC2500_PATABLE_ADDR, patable);
+}
+
 void cc2500_calibrate(void)
 {
 	cc2500_idle();
@@ -759,6 +765,8 @@ void cc2500_rx_pkt_eop(void)
 	uint8_t rxbytes;
 	int l;
 
+	PROF_BEGIN(PROF_CC2500_RX_EOP);
+
 	/* read RX bytes on general registers */
 	rxbytes = CC2500_SPI_ROREG(CC2500_REG_RXBYTES);
 	do {
@@ -831,6 +839,8 @@ void cc2500_rx_pkt_eop(void)
 
 	CC2500_HW_GDO0_CLEAR_FLAG();
 	CC2500_HW_GDO2_CLEAR_FLAG();
+
+	PROF_END(PROF_CC2500_RX_EOP);
 }
 
 /* **************************************************
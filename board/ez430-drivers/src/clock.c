@@ -17,7 +17,10 @@
 
 #include <stdio.h>
 
+#include "isr_compat.h"
+#include "lpm_compat.h"
 #include "clock.h"
+#include "timer.h"
 
 /*
  *  After a PUC, MCLK and SMCLK are sourced from DCOCLK at ~1.1 MHz (see
@@ -32,6 +35,23 @@
  */
 
 static unsigned int mclk_freq_mhz = 0;
+static unsigned char smclk_div = 1;
+/* SMCLK cycles per us, in 1/256 */
+static unsigned int smclk_cycles_per_us_q8 = 1 << 8;
+static clock_busy_cb smclk_busy_cb = NULL;
+static clock_change_cb change_cb[CLOCK_MAX_CHANGE_CB];
+
+static unsigned int vlo_freq_hz = VLO_FREQ_NOMINAL;
+/* VLO ticks per ms, in 1/1024 */
+static unsigned long vlo_ticks_per_ms_q10 =
+    ((unsigned long)VLO_FREQ_NOMINAL << 10) / 1000;
+/* ms per VLO tick, in 1/65536 */
+static unsigned int vlo_ms_per_tick_q16 =
+    (1000UL << 16) / VLO_FREQ_NOMINAL;
+
+/* clock_now_ms = now_ms_base + (ticks - now_ticks_base) ms per tick */
+static uint32_t now_ticks_base;
+static uint32_t now_ms_base;
 
 /***************************************************************
  * we have to wait OFIFG to be sure the switch is ok
@@ -45,8 +65,18 @@ int get_mclk_freq_mhz()
 	return mclk_freq_mhz;
 }
 
+unsigned long get_smclk_freq_hz()
+{
+	/* DCO defaults to ~1.1 MHz after PUC, rounded to 1 MHz as elsewhere */
+	unsigned long dco_hz = (mclk_freq_mhz ? mclk_freq_mhz : 1) * 1000000UL;
+	return dco_hz / smclk_div;
+}
+
 static void set_mcu_speed(unsigned char dco_mhz, unsigned char smclk_divider)
 {
+	/* lowest DCO step first, the new range with the old step could
+	 * overshoot the target frequency */
+	DCOCTL = 0;
 	switch (dco_mhz) {
 	case 1:
 		BCSCTL1 = CALBC1_1MHZ;
@@ -88,71 +118,244 @@ static void set_mcu_speed(unsigned char dco_mhz, unsigned char smclk_divider)
 	WAIT_CRISTAL();
 
 	mclk_freq_mhz = dco_mhz;
+	smclk_div = smclk_divider;
+	smclk_cycles_per_us_q8 = ((unsigned int)dco_mhz << 8) / smclk_divider;
+}
+
+/***************************************************************
+ * Clock manager
+ ***************************************************************/
+
+int clock_register_change_cb(clock_change_cb cb)
+{
+	unsigned char i;
+
+	for (i = 0; i < CLOCK_MAX_CHANGE_CB; i++) {
+		if (change_cb[i] == cb)
+			return 0;
+		if (change_cb[i] == NULL) {
+			change_cb[i] = cb;
+			return 0;
+		}
+	}
+	return -1;
+}
+
+int clock_set_speed(unsigned char dco_mhz, unsigned char smclk_divider)
+{
+	unsigned long smclk_hz;
+	unsigned int state;
+	unsigned char i;
+
+	if ((dco_mhz != 1 && dco_mhz != 8 && dco_mhz != 12 && dco_mhz != 16)
+	    || (smclk_divider != 1 && smclk_divider != 2 &&
+		smclk_divider != 4 && smclk_divider != 8))
+		return -1;
+
+	smclk_hz = dco_mhz * 1000000UL / smclk_divider;
+	for (i = 0; i < CLOCK_MAX_CHANGE_CB && change_cb[i] != NULL; i++)
+		change_cb[i] (CLOCK_CHANGE_PRE, smclk_hz);
+
+	state = __get_interrupt_state();
+	__disable_interrupt();
+	set_mcu_speed(dco_mhz, smclk_divider);
+	for (i = 0; i < CLOCK_MAX_CHANGE_CB && change_cb[i] != NULL; i++)
+		change_cb[i] (CLOCK_CHANGE_POST, smclk_hz);
+	__set_interrupt_state(state);
+
+	return 0;
 }
 
 void set_mcu_speed_dco_mclk_1MHz_smclk_1MHz()
 {
-	set_mcu_speed(1, 1);
+	clock_set_speed(1, 1);
 }
 
 void set_mcu_speed_dco_mclk_8MHz_smclk_8MHz()
 {
-	set_mcu_speed(8, 1);
+	clock_set_speed(8, 1);
 }
 
 void set_mcu_speed_dco_mclk_8MHz_smclk_4MHz()
 {
-	set_mcu_speed(8, 2);
+	clock_set_speed(8, 2);
 }
 
 void set_mcu_speed_dco_mclk_8MHz_smclk_2MHz()
 {
-	set_mcu_speed(8, 4);
+	clock_set_speed(8, 4);
 }
 
 void set_mcu_speed_dco_mclk_8MHz_smclk_1MHz()
 {
-	set_mcu_speed(8, 8);
+	clock_set_speed(8, 8);
 }
 
 void set_mcu_speed_dco_mclk_12MHz_smclk_12MHz()
 {
-	set_mcu_speed(12, 1);
+	clock_set_speed(12, 1);
 }
 
 void set_mcu_speed_dco_mclk_12MHz_smclk_6MHz()
 {
-	set_mcu_speed(12, 2);
+	clock_set_speed(12, 2);
 }
 
 void set_mcu_speed_dco_mclk_12MHz_smclk_3MHz()
 {
-	set_mcu_speed(12, 4);
+	clock_set_speed(12, 4);
 }
 
 void set_mcu_speed_dco_mclk_12MHz_smclk_1_5MHz()
 {
-	set_mcu_speed(12, 8);
+	clock_set_speed(12, 8);
 }
 
 void set_mcu_speed_dco_mclk_16MHz_smclk_16MHz()
 {
-	set_mcu_speed(16, 1);
+	clock_set_speed(16, 1);
 }
 
 void set_mcu_speed_dco_mclk_16MHz_smclk_8MHz()
 {
-	set_mcu_speed(16, 2);
+	clock_set_speed(16, 2);
 }
 
 void set_mcu_speed_dco_mclk_16MHz_smclk_4MHz()
 {
-	set_mcu_speed(16, 4);
+	clock_set_speed(16, 4);
 }
 
 void set_mcu_speed_dco_mclk_16MHz_smclk_2MHz()
 {
-	set_mcu_speed(16, 8);
+	clock_set_speed(16, 8);
+}
+
+/***************************************************************
+ * Monotonic clock
+ ***************************************************************/
+
+uint32_t clock_now_ticks32(void)
+{
+	return timer_service_now();
+}
+
+static uint32_t clock_ticks_to_ms(uint32_t ticks, unsigned int ms_per_tick)
+{
+	/* split so that the product cannot overflow */
+	return (ticks >> 16) * ms_per_tick +
+	    (((ticks & 0xFFFF) * ms_per_tick) >> 16);
+}
+
+/* moves the ms origin to now, before the ms per tick change or the
+ * tick difference becomes ambiguous */
+static void clock_rebase_ms(void)
+{
+	unsigned int state = __get_interrupt_state();
+	uint32_t ticks;
+
+	__disable_interrupt();
+	ticks = timer_service_now();
+	now_ms_base += clock_ticks_to_ms(ticks - now_ticks_base,
+					 vlo_ms_per_tick_q16);
+	now_ticks_base = ticks;
+
+	__set_interrupt_state(state);
+}
+
+/* the bases and the rate are taken together, a rebase or a
+ * recalibration from an interrupt could otherwise be seen half done */
+uint32_t clock_now_ms(void)
+{
+	unsigned int state = __get_interrupt_state();
+	unsigned int ms_per_tick;
+	uint32_t ticks, ms_base;
+
+	__disable_interrupt();
+	ticks = timer_service_now() - now_ticks_base;
+	if (ticks & 0x80000000UL) {
+		clock_rebase_ms();
+		ticks = timer_service_now() - now_ticks_base;
+	}
+	ms_base = now_ms_base;
+	ms_per_tick = vlo_ms_per_tick_q16;
+	__set_interrupt_state(state);
+
+	return ms_base + clock_ticks_to_ms(ticks, ms_per_tick);
+}
+
+/***************************************************************
+ * VLO calibration
+ ***************************************************************/
+
+/* ACLK periods per measure: 8 periods of a 4 kHz VLO are 32000
+ * cycles of a 16 MHz SMCLK, the capture difference stays 16 bit */
+#define VLO_CAL_PERIODS 8
+/* plausible VLO range, beyond the data sheet 4 to 20 kHz */
+#define VLO_CAL_MIN_HZ 2000
+#define VLO_CAL_MAX_HZ 30000
+
+unsigned int clock_calibrate_vlo(void)
+{
+	unsigned int tbctl = TBCTL;
+	unsigned int tbcctl0 = TBCCTL0;
+	unsigned int first = 0, last = 0, cycles, guard, state;
+	unsigned long hz = 0;
+	unsigned char i;
+
+	BCSCTL3 |= LFXT1S_2;	// LFXT1 = VLO
+	if ((TBCTL & (TBSSEL_3 | ID_3 | MC_3)) != (TBSSEL_2 | MC_2))
+		TBCTL = TBSSEL_2 + MC_2;	// SMCLK, continuous mode
+	TBCCTL0 = CM_1 + CCIS_1 + CAP;	// capture ACLK (CCI0B) rising edges
+	TBCCTL0 &= ~COV;
+
+	/* each capture is read before the next edge, otherwise COV is set */
+	for (i = 0; i <= VLO_CAL_PERIODS; i++) {
+		TBCCTL0 &= ~CCIFG;
+		guard = 0xFFFF;
+		while (!(TBCCTL0 & CCIFG))
+			if (--guard == 0)
+				goto restore;	/* ACLK is not running */
+		last = TBCCR0;
+		if (i == 0)
+			first = last;
+	}
+
+	/* an interrupt delayed us past an edge, captures were lost */
+	if (TBCCTL0 & COV)
+		goto restore;
+
+	cycles = last - first;
+	hz = (get_smclk_freq_hz() * VLO_CAL_PERIODS + cycles / 2) / cycles;
+	if (hz < VLO_CAL_MIN_HZ || hz > VLO_CAL_MAX_HZ) {
+		hz = 0;
+		goto restore;
+	}
+
+	state = __get_interrupt_state();
+	__disable_interrupt();
+	clock_rebase_ms();
+	vlo_freq_hz = hz;
+	vlo_ticks_per_ms_q10 = (hz << 10) / 1000;
+	vlo_ms_per_tick_q16 = (1000UL << 16) / hz;
+	__set_interrupt_state(state);
+
+ restore:
+	TBCCTL0 = tbcctl0;
+	TBCTL = tbctl;
+	return hz;
+}
+
+unsigned int get_vlo_freq_hz(void)
+{
+	return vlo_freq_hz;
+}
+
+unsigned long clock_vlo_ms_to_ticks(unsigned long ms)
+{
+	/* split so that the product cannot overflow */
+	return (ms >> 10) * vlo_ticks_per_ms_q10 +
+	    (((ms & 1023) * vlo_ticks_per_ms_q10) >> 10);
 }
 
 /* the IAR version of loop_4_cycles is defined in loop_4_cycles.s43 */
@@ -169,7 +372,7 @@ void loop_4_cycles(register uint32_t n)
 }
 #endif
 
-void inline delay_usec(unsigned int usec)
+static void delay_usec_spin(unsigned int usec)
 {
 	uint32_t loops;
 	switch (mclk_freq_mhz) {
@@ -192,7 +395,7 @@ void inline delay_usec(unsigned int usec)
 	loop_4_cycles(loops);
 }
 
-void delay_ms(unsigned int ms)
+static void delay_ms_spin(unsigned int ms)
 {
 	unsigned int i;
 	uint32_t loops;
@@ -223,6 +426,98 @@ void delay_ms(unsigned int ms)
 	}
 }
 
+/***************************************************************
+ * Sleeping delays
+ ***************************************************************/
+
+/* below, entering and leaving LPM0 costs about as much as spinning */
+#define DELAY_SLEEP_MIN_CYCLES 128
+
+void clock_register_smclk_busy_cb(clock_busy_cb cb)
+{
+	smclk_busy_cb = cb;
+}
+
+ISR(TIMERB1, Timer_B1)
+{
+	switch (TBIV) {
+	case 2:		/* TBCCR1, end of delay_sleep_smclk */
+		TBCCTL1 &= ~CCIE;
+		LPM_OFF_ON_EXIT;
+		break;
+	}
+}
+
+/* sleeps in LPM0 for cycles SMCLK cycles, interrupts enabled */
+static void delay_sleep_smclk(uint32_t cycles)
+{
+	unsigned int tbctl = TBCTL;
+	unsigned int chunk;
+
+	if ((TBCTL & (TBSSEL_3 | ID_3 | MC_3)) != (TBSSEL_2 | MC_2))
+		TBCTL = TBSSEL_2 + MC_2;	// SMCLK, continuous mode
+
+	while (cycles > 0) {
+		chunk = cycles > 0xF000 ? 0xF000 : cycles;
+		cycles -= chunk;
+
+		__disable_interrupt();
+		TBCCR1 = TBR + chunk;
+		TBCCTL1 = CCIE;
+		while (TBCCTL1 & CCIE) {
+			LPM_GIE(0);
+			__disable_interrupt();
+		}
+		__enable_interrupt();
+	}
+
+	TBCTL = tbctl;
+}
+
+/* sleeps on a timer service event, interrupts enabled */
+static void delay_sleep_vlo(unsigned int ms)
+{
+	struct timer_event ev = { NULL };
+
+	/* one more tick, as now may be just before a tick edge */
+	timer_event_start(&ev, clock_vlo_ms_to_ticks(ms) + 1, 0, NULL);
+
+	__disable_interrupt();
+	while (timer_event_pending(&ev)) {
+		if (smclk_busy_cb != NULL && smclk_busy_cb())
+			LPM_GIE(0);
+		else
+			LPM_GIE(3);
+		__disable_interrupt();
+	}
+	__enable_interrupt();
+}
+
+void delay_usec(unsigned int usec)
+{
+	uint32_t cycles = ((uint32_t) usec * smclk_cycles_per_us_q8) >> 8;
+
+	if (cycles >= DELAY_SLEEP_MIN_CYCLES &&
+	    (__get_interrupt_state() & GIE))
+		delay_sleep_smclk(cycles);
+	else
+		delay_usec_spin(usec);
+}
+
+void delay_ms(unsigned int ms)
+{
+	if (ms == 0)
+		return;
+
+	if (!(__get_interrupt_state() & GIE))
+		delay_ms_spin(ms);
+	else if (timer_service_started())
+		delay_sleep_vlo(ms);
+	else
+		delay_sleep_smclk((uint32_t) ms *
+				  ((1000UL * smclk_cycles_per_us_q8) >> 8));
+}
+
 /***************************************************************
  *
  ***************************************************************/
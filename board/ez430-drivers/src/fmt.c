@@ -0,0 +1,92 @@
+/**
+ *  \file   fmt.c
+ *  \brief  eZ430-RF2500, printf-free integer formatting on the uart
+ **/
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "uart.h"
+#include "fmt.h"
+
+static const char hex_digits[16] = "0123456789ABCDEF";
+
+static const uint16_t pow10[] = { 10000, 1000, 100, 10, 1 };
+
+void fmt_u8_hex(uint8_t value)
+{
+	putchar(hex_digits[value >> 4]);
+	putchar(hex_digits[value & 0x0F]);
+}
+
+void fmt_u16_hex(uint16_t value)
+{
+	fmt_u8_hex(value >> 8);
+	fmt_u8_hex(value & 0xFF);
+}
+
+/* prints value with `decimals` digits after a decimal point */
+static void fmt_dec(uint16_t value, unsigned char decimals)
+{
+	unsigned char i;
+	unsigned char n = sizeof(pow10) / sizeof(pow10[0]);
+	char digit;
+	int started = 0;
+
+	for (i = 0; i < n; i++) {
+		digit = '0';
+		while (value >= pow10[i]) {
+			value -= pow10[i];
+			digit++;
+		}
+		if (i == n - decimals) {
+			if (!started)
+				putchar('0');
+			putchar('.');
+			started = 1;
+		}
+		/* leading zeros are skipped, but the units digit is kept */
+		if (digit != '0' || started || i == n - 1) {
+			putchar(digit);
+			started = 1;
+		}
+	}
+}
+
+void fmt_u16_dec(uint16_t value)
+{
+	fmt_dec(value, 0);
+}
+
+void fmt_i16_dec(int16_t value)
+{
+	if (value < 0) {
+		putchar('-');
+		/* -32768 is fine once cast to unsigned */
+		fmt_dec(-(uint16_t)value, 0);
+	} else {
+		fmt_dec(value, 0);
+	}
+}
+
+void fmt_decicelsius(int16_t value)
+{
+	if (value < 0) {
+		putchar('-');
+		fmt_dec(-(uint16_t)value, 1);
+	} else {
+		fmt_dec(value, 1);
+	}
+}
+
+void fmt_str(const char *str)
+{
+	while (*str)
+		putchar(*str++);
+}
+
+void fmt_eol(void)
+{
+	putchar('\r');
+	putchar('\n');
+}
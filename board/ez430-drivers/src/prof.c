@@ -0,0 +1,92 @@
+/**
+ *  \file   prof.c
+ *  \brief  cycle profiling probes on timer B
+ **/
+
+#if defined(__GNUC__) && defined(__MSP430__)
+/* This is the MSPGCC compiler */
+#include <msp430.h>
+#include <legacymsp430.h>
+#elif defined(__IAR_SYSTEMS_ICC__)
+/* This is the IAR compiler */
+#include <io430.h>
+#endif
+
+#include <stdio.h>
+
+#include "clock.h"
+#include "fmt.h"
+#include "prof.h"
+
+struct prof_probe prof_table[PROF_MAX_PROBES];
+
+void prof_reset(void)
+{
+	unsigned char i;
+	unsigned int state = __get_interrupt_state();
+	__disable_interrupt();
+
+	for (i = 0; i < PROF_MAX_PROBES; i++) {
+		prof_table[i].count = 0;
+		prof_table[i].min = 0xFFFF;
+		prof_table[i].max = 0;
+		prof_table[i].total = 0;
+	}
+
+	__set_interrupt_state(state);
+}
+
+void prof_init(void)
+{
+	prof_reset();
+	TBCTL = TBSSEL_2 + MC_2;	// SMCLK, continuous mode
+}
+
+void prof_end(uint8_t id, uint16_t now)
+{
+	struct prof_probe *p = &prof_table[id];
+	uint16_t cycles = now - p->start;
+
+	if (p->count != 0xFFFF)
+		p->count++;
+	if (cycles < p->min)
+		p->min = cycles;
+	if (cycles > p->max)
+		p->max = cycles;
+	p->total += cycles;
+}
+
+void prof_dump(void)
+{
+	struct prof_probe p;
+	unsigned char i;
+	unsigned int state;
+
+	fmt_str("prof,smclk_khz,");
+	fmt_u16_dec(get_smclk_freq_hz() / 1000);
+	fmt_eol();
+
+	for (i = 0; i < PROF_MAX_PROBES; i++) {
+		/* consistent copy, the probe may be updated by an ISR */
+		state = __get_interrupt_state();
+		__disable_interrupt();
+		p = prof_table[i];
+		__set_interrupt_state(state);
+
+		if (p.count == 0)
+			continue;
+
+		fmt_str("prof,");
+		fmt_u16_dec(i);
+		fmt_str(",count,");
+		fmt_u16_dec(p.count);
+		fmt_str(",min,");
+		fmt_u16_dec(p.min);
+		fmt_str(",max,");
+		fmt_u16_dec(p.max);
+		fmt_str(",total,0x");
+		fmt_u16_hex(p.total >> 16);
+		fmt_u16_hex(p.total & 0xFFFF);
+		fmt_eol();
+	}
+}
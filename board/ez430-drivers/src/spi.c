@@ -17,6 +17,7 @@
 #include "io_compat.h"
 #include <stdio.h>
 
+#include "clock.h"
 #include "spi.h"
 
 /* ************************************************** */
@@ -110,12 +111,30 @@
             UCB0CTL1 = UCSWRST;                           \
             UCB0CTL1 = UCSWRST | UCSSEL1;                 \
             UCB0CTL0 = UCCKPH | UCMSB | UCMST | UCSYNC;   \
-            UCB0BR0  = 2;                                 \
-            UCB0BR1  = 0;                                 \
             SPI_CONFIG_PORT();				\
             UCB0CTL1 &= ~UCSWRST;                         \
        )
 
+/* CC2500 burst access SCLK limit is 6.5 MHz */
+#define SPI_SCLK_MAX_HZ 4000000UL
+
+/* SCLK = SMCLK / UCB0BR, as fast as allowed */
+static void spi_set_divider(unsigned long smclk_hz)
+{
+	unsigned int br = (smclk_hz + SPI_SCLK_MAX_HZ - 1) / SPI_SCLK_MAX_HZ;
+
+	UCB0CTL1 |= UCSWRST;
+	UCB0BR0 = br & 0xFF;
+	UCB0BR1 = br >> 8;
+	UCB0CTL1 &= ~UCSWRST;
+}
+
+static void spi_clock_change(int phase, unsigned long smclk_hz)
+{
+	if (phase == CLOCK_CHANGE_POST)
+		spi_set_divider(smclk_hz);
+}
+
 void spi_init(void)
 {
 	/* configure all SPI related pins */
@@ -129,6 +148,8 @@ void spi_init(void)
 
 	/* initialize the SPI registers */
 	SPI_INIT();
+	spi_set_divider(get_smclk_freq_hz());
+	clock_register_change_cb(spi_clock_change);
 }
 
 /* ************************************************** */
@@ -18,6 +18,7 @@
 
 #include "isr_compat.h"
 #include "lpm_compat.h"
+#include "clock.h"
 #include "timer.h"
 
 /* ************************************************** */
@@ -62,12 +63,9 @@ void timerA_start_ticks(unsigned ticks)
 	TACTL = TASSEL_1 + MC_1;	// ACLK, upmode
 }
 
-#define VLO_FREQ 12000
-#define TICKS_IN_MS (VLO_FREQ/1000)
-
 void timerA_start_milliseconds(unsigned ms)
 {
-	timerA_start_ticks(ms * TICKS_IN_MS);
+	timerA_start_ticks(clock_vlo_ms_to_ticks(ms));
 }
 
 void timerA_stop(void)
@@ -75,6 +73,203 @@ void timerA_stop(void)
 	TACTL = 0;
 }
 
+/* ************************************************** */
+/* Timer service, TimerA continuous mode on ACLK      */
+/* ************************************************** */
+
+static struct timer_event *volatile timer_events;
+static volatile uint16_t timerA_overflows;
+static int timer_service_running;
+
+/* TAR extended to 32 bits, interrupts must be disabled */
+static uint32_t timer_service_now_locked(void)
+{
+	uint16_t high = timerA_overflows;
+	uint16_t low = TAR;
+
+	/* TAR wrapped but the overflow interrupt has not run yet */
+	if ((TACTL & TAIFG) && low < 0x8000)
+		high++;
+	return ((uint32_t) high << 16) | low;
+}
+
+uint32_t timer_service_now(void)
+{
+	uint32_t now;
+	unsigned int state = __get_interrupt_state();
+	__disable_interrupt();
+	now = timer_service_now_locked();
+	__set_interrupt_state(state);
+	return now;
+}
+
+uint32_t timer_ms_to_ticks(uint32_t ms)
+{
+	return clock_vlo_ms_to_ticks(ms);
+}
+
+/* programs TACCR1 for the head of the list, interrupts disabled */
+static void timer_service_program(void)
+{
+	uint32_t now;
+	int32_t delta;
+
+	if (timer_events == NULL) {
+		TACCTL1 = 0;
+		return;
+	}
+
+	now = timer_service_now_locked();
+	delta = (int32_t) (timer_events->deadline - now);
+
+	if (delta <= 1) {
+		/* due or too close to be caught by the comparator */
+		TACCR1 = TAR;
+		TACCTL1 = CCIE | CCIFG;
+	} else if (delta < 0x10000) {
+		TACCR1 = (uint16_t) timer_events->deadline;
+		TACCTL1 = CCIE;
+	} else {
+		/* beyond this TAR period, wait for the next overflows */
+		TACCTL1 = 0;
+	}
+}
+
+/* sorted insert, interrupts disabled */
+static void timer_service_insert(struct timer_event *ev)
+{
+	struct timer_event *volatile *p = &timer_events;
+	uint32_t now = timer_service_now_locked();
+
+	while (*p != NULL && (int32_t) ((*p)->deadline - now)
+	       <= (int32_t) (ev->deadline - now))
+		p = &(*p)->next;
+
+	ev->next = *p;
+	*p = ev;
+	ev->active = 1;
+}
+
+/* unlink, interrupts disabled */
+static void timer_service_remove(struct timer_event *ev)
+{
+	struct timer_event *volatile *p = &timer_events;
+
+	while (*p != NULL && *p != ev)
+		p = &(*p)->next;
+	if (*p != NULL)
+		*p = ev->next;
+	ev->active = 0;
+}
+
+void timer_service_init(void)
+{
+	timer_events = NULL;
+	timerA_overflows = 0;
+	timerA_cb = NULL;
+	timerA_wakeup = 0;
+
+	BCSCTL3 |= LFXT1S_2;	// LFXT1 = VLO
+	TACCTL1 = 0;
+	TAR = 0;
+	TACTL = TASSEL_1 + MC_2 + TAIE;	// ACLK, continuous mode
+	timer_service_running = 1;
+}
+
+int timer_service_started(void)
+{
+	return timer_service_running;
+}
+
+void timer_event_start(struct timer_event *ev, uint32_t delay,
+		       uint32_t period, timer_event_cb cb)
+{
+	unsigned int state = __get_interrupt_state();
+	__disable_interrupt();
+
+	if (ev->active)
+		timer_service_remove(ev);
+	ev->deadline = timer_service_now_locked() + delay;
+	ev->period = period;
+	ev->cb = cb;
+	ev->fired = 0;
+	timer_service_insert(ev);
+	timer_service_program();
+
+	__set_interrupt_state(state);
+}
+
+void timer_event_stop(struct timer_event *ev)
+{
+	unsigned int state = __get_interrupt_state();
+	__disable_interrupt();
+
+	if (ev->active) {
+		timer_service_remove(ev);
+		timer_service_program();
+	}
+
+	__set_interrupt_state(state);
+}
+
+int timer_event_pending(struct timer_event *ev)
+{
+	return ev->active;
+}
+
+int timer_event_expired(struct timer_event *ev)
+{
+	if (ev->fired) {
+		ev->fired = 0;
+		return 1;
+	}
+	return 0;
+}
+
+/* runs the expired events, returns non 0 to leave LPM */
+static int timer_service_run(void)
+{
+	struct timer_event *ev;
+	int wakeup = 0;
+
+	while (timer_events != NULL &&
+	       (int32_t) (timer_events->deadline - timer_service_now_locked()) <= 0) {
+		ev = timer_events;
+		timer_events = ev->next;
+		ev->active = 0;
+
+		if (ev->period != 0) {
+			ev->deadline += ev->period;
+			timer_service_insert(ev);
+		}
+
+		ev->fired = 1;
+		if (ev->cb == NULL || ev->cb(ev) != 0)
+			wakeup = 1;
+	}
+
+	timer_service_program();
+	return wakeup;
+}
+
+ISR(TIMERA1, Timer_A1)
+{
+	int wakeup = 0;
+
+	switch (TAIV) {
+	case 2:		/* TACCR1 */
+		wakeup = timer_service_run();
+		break;
+	case 10:		/* TAR overflow */
+		timerA_overflows++;
+		timer_service_program();
+		break;
+	}
+
+	if (wakeup)
+		LPM_OFF_ON_EXIT;
+}
+
 /* ************************************************** */
 /* TimerB on VLO 12kHz                                */
 /* ************************************************** */
@@ -119,7 +314,7 @@ void timerB_start_ticks(unsigned ticks)
 
 void timerB_start_milliseconds(unsigned ms)
 {
-	timerB_start_ticks(ms * TICKS_IN_MS);
+	timerB_start_ticks(clock_vlo_ms_to_ticks(ms));
 }
 
 void timerB_stop(void)
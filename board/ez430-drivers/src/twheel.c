@@ -0,0 +1,214 @@
+/**
+ *  \file   twheel.c
+ *  \brief  hierarchical timing wheel for many concurrent timeouts
+ **/
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(__GNUC__) && defined(__MSP430__)
+/* This is the MSPGCC compiler */
+#include <msp430.h>
+#include <legacymsp430.h>
+#elif defined(__IAR_SYSTEMS_ICC__)
+/* This is the IAR compiler */
+#include <io430.h>
+#endif
+
+#include "twheel.h"
+
+#if defined(__MSP430__) || defined(__IAR_SYSTEMS_ICC__)
+#define TWHEEL_TARGET 1
+#include "timer.h"
+#endif
+
+/* ************************************************** */
+/* Wheel storage                                      */
+/* ************************************************** */
+
+#define TWHEEL_MASK (TWHEEL_SLOTS - 1)
+
+static struct twheel_timer *twheel[TWHEEL_LEVELS][TWHEEL_SLOTS];
+static uint16_t twheel_now;
+static unsigned int twheel_pending_count;
+
+/* ************************************************** */
+/* Tick source and locking                            */
+/* ************************************************** */
+
+#if defined(TWHEEL_TARGET)
+
+static struct timer_event twheel_tick_event;
+
+static int twheel_tick_cb(struct timer_event *ev)
+{
+	return twheel_tick();
+}
+
+static void twheel_tick_start(void)
+{
+	timer_event_start(&twheel_tick_event,
+			  timer_ms_to_ticks(TWHEEL_TICK_MS),
+			  timer_ms_to_ticks(TWHEEL_TICK_MS), twheel_tick_cb);
+}
+
+static void twheel_tick_stop(void)
+{
+	timer_event_stop(&twheel_tick_event);
+}
+
+#define TWHEEL_LOCK()	unsigned int twheel_state = __get_interrupt_state(); \
+			__disable_interrupt()
+#define TWHEEL_UNLOCK()	__set_interrupt_state(twheel_state)
+
+#else /* host build, driven by explicit twheel_tick calls */
+
+#define twheel_tick_start()
+#define twheel_tick_stop()
+#define TWHEEL_LOCK()
+#define TWHEEL_UNLOCK()
+
+#endif
+
+/* ************************************************** */
+/* Lists                                              */
+/* ************************************************** */
+
+static void twheel_link(struct twheel_timer **head, struct twheel_timer *t)
+{
+	t->next = *head;
+	if (t->next != NULL)
+		t->next->pprev = &t->next;
+	*head = t;
+	t->pprev = head;
+}
+
+static void twheel_unlink(struct twheel_timer *t)
+{
+	*t->pprev = t->next;
+	if (t->next != NULL)
+		t->next->pprev = t->pprev;
+	t->pprev = NULL;
+}
+
+/* hashes t into its slot from its distance to now */
+static void twheel_insert(struct twheel_timer *t)
+{
+	uint16_t delta = t->expires - twheel_now;
+	uint8_t level = 0;
+
+	while (level < TWHEEL_LEVELS - 1 &&
+	       (delta >> (TWHEEL_BITS * (level + 1))) != 0)
+		level++;
+
+	twheel_link(&twheel[level][(t->expires >> (TWHEEL_BITS * level)) &
+				   TWHEEL_MASK], t);
+}
+
+/* moves a slot of an upper level down to the lower levels */
+static void twheel_cascade(uint8_t level)
+{
+	struct twheel_timer **head;
+	struct twheel_timer *t;
+
+	head = &twheel[level][(twheel_now >> (TWHEEL_BITS * level)) &
+			      TWHEEL_MASK];
+	while ((t = *head) != NULL) {
+		twheel_unlink(t);
+		twheel_insert(t);
+	}
+}
+
+/* ************************************************** */
+/* API                                                */
+/* ************************************************** */
+
+void twheel_init(void)
+{
+	uint8_t level, slot;
+
+	for (level = 0; level < TWHEEL_LEVELS; level++)
+		for (slot = 0; slot < TWHEEL_SLOTS; slot++)
+			twheel[level][slot] = NULL;
+	twheel_now = 0;
+	twheel_pending_count = 0;
+	twheel_tick_stop();
+}
+
+void twheel_start(struct twheel_timer *t, uint16_t ticks, twheel_cb cb)
+{
+	TWHEEL_LOCK();
+
+	if (t->pprev != NULL)
+		twheel_unlink(t);
+	else if (twheel_pending_count++ == 0)
+		twheel_tick_start();
+
+	if (ticks == 0)
+		ticks = 1;
+	if (ticks > TWHEEL_MAX_TICKS)
+		ticks = TWHEEL_MAX_TICKS;
+	t->expires = twheel_now + ticks;
+	t->cb = cb;
+	twheel_insert(t);
+
+	TWHEEL_UNLOCK();
+}
+
+void twheel_stop(struct twheel_timer *t)
+{
+	TWHEEL_LOCK();
+
+	if (t->pprev != NULL) {
+		twheel_unlink(t);
+		if (--twheel_pending_count == 0)
+			twheel_tick_stop();
+	}
+
+	TWHEEL_UNLOCK();
+}
+
+int twheel_pending(struct twheel_timer *t)
+{
+	return t->pprev != NULL;
+}
+
+unsigned int twheel_count(void)
+{
+	return twheel_pending_count;
+}
+
+int twheel_tick(void)
+{
+	struct twheel_timer *expired, *t;
+	uint8_t level;
+	int wakeup = 0;
+
+	twheel_now++;
+
+	/* a lower level wrapped, refill it from the level above */
+	for (level = 1; level < TWHEEL_LEVELS; level++) {
+		if ((twheel_now & ((1U << (TWHEEL_BITS * level)) - 1)) != 0)
+			break;
+	}
+	while (--level > 0)
+		twheel_cascade(level);
+
+	/* detach the slot so that callbacks can restart their timer */
+	expired = twheel[0][twheel_now & TWHEEL_MASK];
+	twheel[0][twheel_now & TWHEEL_MASK] = NULL;
+	if (expired != NULL)
+		expired->pprev = &expired;
+
+	while ((t = expired) != NULL) {
+		twheel_unlink(t);
+		twheel_pending_count--;
+		if (t->cb == NULL || t->cb(t) != 0)
+			wakeup = 1;
+	}
+
+	if (twheel_pending_count == 0)
+		twheel_tick_stop();
+
+	return wakeup;
+}
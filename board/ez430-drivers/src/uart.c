@@ -18,6 +18,7 @@
 
 #include "isr_compat.h"
 #include "lpm_compat.h"
+#include "clock.h"
 #include "uart.h"
 
 /* ************************************************** */
@@ -88,6 +89,117 @@ void uart_init(int config)
 	uart_cb = NULL;
 }
 
+/*
+ * Baud rate generation, user manual 15.3.10 / 15.3.13
+ *
+ *   N = BRCLK / baudrate
+ *
+ *   N >= 16 : oversampling mode, UCOS16 = 1
+ *             UCBRx  = INT(N/16)
+ *             UCBRFx = round((N/16 - INT(N/16)) * 16)
+ *   N < 16  : low frequency mode, UCOS16 = 0
+ *             UCBRx  = INT(N)
+ *             UCBRSx = round((N - INT(N)) * 8)
+ *
+ * N is computed in 1/16 units to stay in 32 bits integer arithmetic,
+ * the low frequency mode requires BRCLK >= 3 * baudrate.
+ */
+
+static unsigned long uart_baudrate;
+static unsigned long uart_requested_baudrate;
+static int uart_baud_error;
+
+/* programs the dividers for brclk, leaves the uart untouched on error */
+static int uart_set_baudrate(unsigned long brclk, unsigned long baudrate)
+{
+	unsigned long n16;
+	unsigned long br;
+	unsigned long effective;
+	unsigned char mctl;
+
+	if (baudrate == 0)
+		return -1;
+
+	n16 = (brclk * 16 + baudrate / 2) / baudrate;
+
+	if (n16 >= 16 * 16) {
+		unsigned char brf = ((n16 % 256) + 8) / 16;
+		br = n16 / 256;
+		if (brf == 16) {
+			br++;
+			brf = 0;
+		}
+		mctl = (brf << 4) | UCOS16;
+		effective = (brclk + (16 * br + brf) / 2) / (16 * br + brf);
+	} else {
+		unsigned char brs = ((n16 % 16) + 1) / 2;
+		br = n16 / 16;
+		if (brs == 8) {
+			br++;
+			brs = 0;
+		}
+		if (br < 3)
+			return -1;
+		mctl = brs << 1;
+		effective = (brclk * 8 + (8 * br + brs) / 2) / (8 * br + brs);
+	}
+
+	if (br > 0xFFFF)
+		return -1;
+
+	P3SEL |= (BIT_TX | BIT_RX);	/* uart   */
+	P3DIR |= (BIT_TX);	/* output */
+	P3DIR &= ~(BIT_RX);	/* input  */
+
+	UCA0CTL1 |= UCSWRST;
+	UCA0CTL1 = UCSSEL_2 | UCSWRST;	// SMCLK
+	UCA0BR0 = br & 0xFF;
+	UCA0BR1 = br >> 8;
+	UCA0MCTL = mctl;
+	UCA0CTL1 &= ~UCSWRST;	// **Initialize USCI state machine**
+
+	uart_baudrate = effective;
+	uart_baud_error = ((long)effective - (long)baudrate) * 1000 / (long)baudrate;
+
+	return 0;
+}
+
+static void uart_clock_change(int phase, unsigned long smclk_hz)
+{
+	if (phase == CLOCK_CHANGE_PRE) {
+		/* bytes in flight would be garbled by the new rate */
+		if (smclk_hz != get_smclk_freq_hz())
+			uart_tx_flush();
+	} else {
+		/* UCSWRST clears the interrupt enables */
+		unsigned char ie = IE2 & (UCA0RXIE | UCA0TXIE);
+		uart_set_baudrate(smclk_hz, uart_requested_baudrate);
+		IE2 |= ie;
+	}
+}
+
+int uart_init_baudrate(unsigned long baudrate)
+{
+	if (uart_set_baudrate(get_smclk_freq_hz(), baudrate) != 0)
+		return -1;
+
+	uart_requested_baudrate = baudrate;
+	uart_cb = NULL;
+	clock_register_change_cb(uart_clock_change);
+
+	return 0;
+}
+
+unsigned long uart_get_baudrate(void)
+{
+	return uart_baudrate;
+}
+
+int uart_get_baud_error(void)
+{
+	return uart_baud_error;
+}
+
 /* ************************************************** */
 /* ************************************************** */
 /* ************************************************** */
@@ -100,13 +212,73 @@ void uart_stop(void)
 /* ************************************************** */
 /* ************************************************** */
 
-int putchar(int c)
+/*
+ * Tx ring buffer: putchar only queues the byte and the USCI_A0 tx
+ * interrupt feeds UCA0TXBUF, so that the application no longer spins
+ * ~1 ms per character at 9600 bauds. Same single producer / single
+ * consumer scheme as the rx ring, head is written by putchar and tail
+ * by the tx ISR.
+ */
+
+#define UART_TX_RING_MASK (UART_TX_RING_SIZE - 1)
+
+static volatile unsigned char tx_ring[UART_TX_RING_SIZE];
+static volatile unsigned char tx_head;
+static volatile unsigned char tx_tail;
+
+/* moves one byte to the USCI by polling, used when interrupts are off */
+static void uart_tx_poll(void)
 {
-	UCA0TXBUF = c;
+	unsigned char tail = tx_tail;
+
 	while (!(IFG2 & UCA0TXIFG)) ;	// USCI_A0 TX buffer ready?
+	UCA0TXBUF = tx_ring[tail & UART_TX_RING_MASK];
+	tx_tail = tail + 1;
+}
+
+int putchar(int c)
+{
+	unsigned char head = tx_head;
+
+	while ((unsigned char)(head - tx_tail) == UART_TX_RING_SIZE) {
+		if (!(__get_interrupt_state() & GIE)) {
+			uart_tx_poll();
+		}
+	}
+
+	tx_ring[head & UART_TX_RING_MASK] = c;
+	tx_head = head + 1;
+	IE2 |= UCA0TXIE;
 	return (unsigned char)c;
 }
 
+unsigned int uart_tx_pending(void)
+{
+	return (unsigned char)(tx_head - tx_tail);
+}
+
+void uart_tx_flush(void)
+{
+	while (tx_head != tx_tail) {
+		if (!(__get_interrupt_state() & GIE)) {
+			uart_tx_poll();
+		}
+	}
+	while (UCA0STAT & UCBUSY) ;	// last byte shifted out
+}
+
+ISR(USCIAB0TX, usart0txirq)
+{
+	unsigned char tail = tx_tail;
+
+	if (tail == tx_head) {
+		IE2 &= ~UCA0TXIE;
+		return;
+	}
+	UCA0TXBUF = tx_ring[tail & UART_TX_RING_MASK];
+	tx_tail = tail + 1;
+}
+
 int uart_getchar(void)
 {
 	int c;
@@ -138,16 +310,171 @@ void uart_register_cb(uart_cb_t cb)
 	}
 }
 
+/* ************************************************** */
+/* Rx ring buffer                                     */
+/* ************************************************** */
+
+/*
+ * Single producer (rx ISR) / single consumer (application) ring.
+ * head is only written by the ISR and tail only by the application,
+ * both are free running bytes so that head - tail is the fill level
+ * without any shared read-modify-write. Frames are counted the same
+ * way with frames_in / frames_out.
+ */
+
+#define UART_RX_RING_MASK (UART_RX_RING_SIZE - 1)
+
+static volatile unsigned char rx_ring[UART_RX_RING_SIZE];
+static volatile unsigned char rx_head;
+static volatile unsigned char rx_tail;
+static volatile unsigned char rx_frames_in;
+static volatile unsigned char rx_frames_out;
+/* written by the ISR only: head after the last delimiter, and set while
+ * the rest of a dropped frame is skipped */
+static volatile unsigned char rx_frame_start;
+static volatile unsigned char rx_resync;
+static volatile int rx_delimiter;
+static volatile unsigned int rx_overruns;
+static volatile unsigned int rx_errors;
+
+void uart_rx_start(int delimiter)
+{
+	uart_dint();
+	uart_cb = NULL;
+	rx_head = 0;
+	rx_tail = 0;
+	rx_frames_in = 0;
+	rx_frames_out = 0;
+	rx_frame_start = 0;
+	rx_resync = 0;
+	rx_delimiter = delimiter;
+	rx_overruns = 0;
+	rx_errors = 0;
+	uart_eint();
+}
+
+unsigned int uart_rx_available(void)
+{
+	return (unsigned char)(rx_head - rx_tail);
+}
+
+int uart_rx_get(unsigned char *data)
+{
+	unsigned char tail = rx_tail;
+
+	if (tail == rx_head)
+		return 0;
+
+	*data = rx_ring[tail & UART_RX_RING_MASK];
+	rx_tail = tail + 1;
+	if (rx_delimiter != UART_RX_NO_DELIMITER && *data == rx_delimiter)
+		rx_frames_out++;
+	return 1;
+}
+
+unsigned int uart_rx_frames(void)
+{
+	return (unsigned char)(rx_frames_in - rx_frames_out);
+}
+
+int uart_rx_get_frame(unsigned char *buffer, int length)
+{
+	unsigned char data;
+	int i = 0;
+
+	if (uart_rx_frames() == 0)
+		return -1;
+
+	/* copies up to the delimiter, the tail of a too long frame is lost */
+	while (uart_rx_get(&data)) {
+		if (data == rx_delimiter)
+			break;
+		if (i < length)
+			buffer[i++] = data;
+	}
+	return i;
+}
+
+unsigned int uart_rx_overruns(void)
+{
+	return rx_overruns;
+}
+
+unsigned int uart_rx_errors(void)
+{
+	return rx_errors;
+}
+
+static void (*volatile rx_notify) (void);
+
+void uart_rx_register_notify(void (*cb) (void))
+{
+	rx_notify = cb;
+}
+
+/* returns non 0 if the application has to be woken up */
+static int uart_rx_put(unsigned char data)
+{
+	unsigned char head = rx_head;
+	unsigned char tail = rx_tail;
+
+	if (rx_delimiter == UART_RX_NO_DELIMITER) {
+		if ((unsigned char)(head - tail) == UART_RX_RING_SIZE) {
+			rx_overruns++;
+			return 1;
+		}
+		rx_ring[head & UART_RX_RING_MASK] = data;
+		rx_head = head + 1;
+		return 1;
+	}
+
+	if (rx_resync) {
+		/* the rest of a dropped frame */
+		if (data == rx_delimiter)
+			rx_resync = 0;
+		return 0;
+	}
+
+	if ((unsigned char)(head - tail) == UART_RX_RING_SIZE) {
+		/* The application only drains complete frames: drop the
+		 * partial one, or the ring would stay full for good. The
+		 * application may have read into it with uart_rx_get. */
+		rx_overruns++;
+		if ((unsigned char)(rx_frame_start - tail) <=
+		    (unsigned char)(head - tail))
+			rx_head = rx_frame_start;
+		else
+			rx_head = rx_frame_start = tail;
+		rx_resync = (data != rx_delimiter);
+		return 0;
+	}
+
+	rx_ring[head & UART_RX_RING_MASK] = data;
+	rx_head = ++head;
+	if (data != rx_delimiter)
+		return 0;
+	rx_frame_start = head;
+	rx_frames_in++;
+	return 1;
+}
+
 ISR(USCIAB0RX, usart0irq)
 {
 	volatile unsigned char dummy;
+	int wakeup;
 	/* Check status register for receive errors. */
 	if (UCA0STAT & UCRXERR) {
 		/* Clear error flags by forcing a dummy read. */
 		dummy = UCA0RXBUF;
 		dummy += 1; /* warning gcc otherwise! */
+		rx_errors++;
 	} else {
-		if (uart_cb(UCA0RXBUF) != 0) {
+		if (uart_cb != NULL)
+			wakeup = uart_cb(UCA0RXBUF);
+		else if ((wakeup = uart_rx_put(UCA0RXBUF)) != 0
+			 && rx_notify != NULL)
+			rx_notify();
+		if (wakeup != 0) {
 			LPM_OFF_ON_EXIT;
 		}
 	}
@@ -7,6 +7,13 @@
 #include <io430.h>
 #endif
 
+#include <stdio.h>
+
+#include "isr_compat.h"
+#include "lpm_compat.h"
+#include "clock.h"
+#include "watchdog.h"
+
 static int watchdog_backup;
 
 void watchdog_stop()
@@ -20,3 +27,70 @@ void watchdog_restore()
 {
 	WDTCTL = WDTPW | watchdog_backup;
 }
+
+/* ************************************************** */
+/* Interval timer                                     */
+/* ************************************************** */
+
+static volatile watchdog_cb watchdog_interval_cb;
+static volatile int watchdog_interval_wakeup;
+static volatile uint32_t watchdog_interval_count;
+static unsigned char watchdog_interval_shift;
+
+ISR(WDT, watchdog_interval_irq)
+{
+	watchdog_interval_count++;
+
+	if (watchdog_interval_cb != NULL)
+		watchdog_interval_cb();
+
+	if (watchdog_interval_wakeup == 1)
+		LPM_OFF_ON_EXIT;
+}
+
+void watchdog_interval_start(int interval)
+{
+	/* VLO periods per tick, as a power of 2 */
+	static const unsigned char shift[] = { 15, 13, 9, 6 };
+
+	interval &= WDTIS0 | WDTIS1;
+	watchdog_interval_shift = shift[interval];
+	watchdog_interval_count = 0;
+
+	BCSCTL3 |= LFXT1S_2;	// LFXT1 = VLO
+	WDTCTL = WDTPW | WDTTMSEL | WDTCNTCL | WDTSSEL | interval;
+	IFG1 &= ~WDTIFG;
+	IE1 |= WDTIE;
+}
+
+void watchdog_interval_stop(void)
+{
+	IE1 &= ~WDTIE;
+	WDTCTL = WDTPW | WDTHOLD;
+}
+
+void watchdog_interval_register_cb(watchdog_cb cb)
+{
+	watchdog_interval_cb = cb;
+}
+
+void watchdog_interval_set_wakeup(int w)
+{
+	watchdog_interval_wakeup = w;
+}
+
+uint32_t watchdog_interval_ticks(void)
+{
+	uint32_t ticks;
+	unsigned int state = __get_interrupt_state();
+	__disable_interrupt();
+	ticks = watchdog_interval_count;
+	__set_interrupt_state(state);
+	return ticks;
+}
+
+unsigned int watchdog_interval_period_ms(void)
+{
+	return ((1000UL << watchdog_interval_shift) + get_vlo_freq_hz() / 2)
+	    / get_vlo_freq_hz();
+}
@@ -18,10 +18,12 @@
 #include <error.h>
 #include <fcntl.h>
 #include <termios.h>
+#include <time.h>
 
 #include <pthread.h>
 
 #include "ez430.h"
+#include "uplink_decoder.h"
 
 #define BAUDRATE B9600
 
@@ -31,6 +33,43 @@
 #define DEBUG_PRINTF(...)
 #endif
 
+/* -b: the sink sends SLIP framed binary readings, print them as CSV,
+ * and keyboard lines are sent as commands ("set interval 500") */
+static int binary_uplink = 0;
+
+/* collects a command line in binary mode, sends it on new line */
+static void command_input(struct ez430_dev *dev, char c)
+{
+	static char line[64];
+	static int len = 0;
+	uint8_t frame[2 * UPLINK_FRAME_MAX + 2];
+	int n;
+
+	if (c != '\r' && c != '\n') {
+		if (len < (int)sizeof(line) - 1)
+			line[len++] = c;
+		fputc(c, stderr);
+		return;
+	}
+
+	fputs("\r\n", stderr);
+	line[len] = 0;
+	len = 0;
+	if (line[0] == 0)
+		return;
+
+	n = uplink_encode_command(line, frame);
+	if (n < 0) {
+		fprintf(stderr, "usage: get|set node_id|interval|channel|power|"
+			"deadband|heartbeat|hang|rx_dropped [value]\r\n"
+			"       prof|sched [reset]\r\n");
+		return;
+	}
+	if (ez430_write(dev, frame, n) < 0) {
+		DEBUG_PRINTF("Error writing command to dev\n");
+	}
+}
+
 /*
  * Read from stdin, send the request to the device
  */
@@ -60,7 +99,9 @@ static void *writer_function(void *arg)
 		if (entry_buffer[0] == 0x1b) {	/* exit on ESC */
 			break;
 		}
-		if (res > 0 && res < MAX_PACKET_SIZE) {
+		if (res > 0 && binary_uplink) {
+			command_input(dev, entry_buffer[0]);
+		} else if (res > 0 && res < MAX_PACKET_SIZE) {
 			entry_buffer[res] = 0;
 
 			/* We let the terminal echo or not the entered char */
@@ -86,7 +127,11 @@ static void *reader_function(void *arg)
 	struct ez430_dev *dev = (struct ez430_dev *)arg;
 	char buf[MAX_PACKET_SIZE + 1];
 	int r = 0;
+	int i, len;
 	int cancel_state;
+	struct uplink_decoder dec;
+
+	uplink_decoder_init(&dec);
 	for (;;) {
 		bzero(&buf, MAX_PACKET_SIZE);
 		/* critical section */
@@ -96,7 +141,33 @@ static void *reader_function(void *arg)
 		/* end of critical section */
 
 		pthread_testcancel();	/* avoid printing when exiting */
-		if (r > 0) {
+		if (r > 0 && binary_uplink) {
+			for (i = 0; i < r; i++) {
+				len = uplink_decode_byte(&dec, (uint8_t)buf[i]);
+				if (len > 0 && dec.frame[0] == UPLINK_TYPE_PARAM)
+					uplink_print_param(stderr, dec.frame, len);
+				else if (len > 0 && dec.frame[0] == UPLINK_TYPE_PROF)
+					uplink_print_prof(stderr, dec.frame, len);
+				else if (len > 0 &&
+					 (dec.frame[0] == UPLINK_TYPE_SCHED ||
+					  dec.frame[0] == UPLINK_TYPE_SCHED_LAT))
+					uplink_print_sched(stderr, dec.frame, len);
+				else if (len > 0 &&
+					 dec.frame[0] == UPLINK_TYPE_POLICY)
+					uplink_print_policy(stderr, dec.frame,
+							    len, time(NULL));
+				else if (len > 0) {
+					uplink_check_gap(stderr, dec.frame, len,
+							 time(NULL));
+					uplink_print_csv(stdout, dec.frame, len);
+				}
+				else if (len < 0)
+					DEBUG_PRINTF("Dropped corrupted frame (%lu so far)\n",
+						     dec.errors);
+			}
+			fflush(stdout);
+			r = 0;
+		} else if (r > 0) {
 			if (r <= MAX_PACKET_SIZE)
 				buf[r] = 0;
 			fprintf(stdout, "%s", buf);
@@ -112,6 +183,17 @@ int main(int argc, char **argv)
 	struct ez430_dev *my_dev = NULL;
 
 	pthread_t reader_task, writer_task;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "b")) != -1) {
+		switch (opt) {
+		case 'b':
+			binary_uplink = 1;
+			break;
+		default:
+			error(EXIT_FAILURE, 0, "Usage: %s [-b]", argv[0]);
+		}
+	}
 
 	my_dev = ez430_open(my_dev);
 
@@ -0,0 +1,341 @@
+/*
+ * Host side decoder for the binary uplink of the demo sink
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "uplink_decoder.h"
+
+void uplink_decoder_init(struct uplink_decoder *dec)
+{
+	memset(dec, 0, sizeof(*dec));
+}
+
+static int uplink_frame_end(struct uplink_decoder *dec)
+{
+	uint16_t crc = UPLINK_CRC16_INIT;
+	int length = dec->length;
+	int overflow = dec->overflow;
+	int i;
+
+	dec->length = 0;
+	dec->escaped = 0;
+	dec->overflow = 0;
+
+	/* back to back END bytes delimit empty frames, not errors */
+	if (length == 0 && !overflow)
+		return 0;
+
+	if (overflow || length < UPLINK_HEADER_LEN + UPLINK_CRC_LEN) {
+		dec->errors++;
+		return -1;
+	}
+
+	for (i = 0; i < length - UPLINK_CRC_LEN; i++)
+		crc = uplink_crc16_update(crc, dec->frame[i]);
+
+	if ((crc & 0xFF) != dec->frame[length - 2] ||
+	    (crc >> 8) != dec->frame[length - 1]) {
+		dec->errors++;
+		return -1;
+	}
+
+	dec->frames++;
+	return length - UPLINK_CRC_LEN;
+}
+
+int uplink_decode_byte(struct uplink_decoder *dec, uint8_t data)
+{
+	if (data == UPLINK_SLIP_END)
+		return uplink_frame_end(dec);
+
+	if (dec->escaped) {
+		dec->escaped = 0;
+		if (data == UPLINK_SLIP_ESC_END)
+			data = UPLINK_SLIP_END;
+		else if (data == UPLINK_SLIP_ESC_ESC)
+			data = UPLINK_SLIP_ESC;
+	} else if (data == UPLINK_SLIP_ESC) {
+		dec->escaped = 1;
+		return 0;
+	}
+
+	if (dec->length < UPLINK_FRAME_MAX)
+		dec->frame[dec->length++] = data;
+	else
+		dec->overflow = 1;
+	return 0;
+}
+
+static const struct {
+	const char *name;
+	uint8_t param;
+} uplink_params[] = {
+	{ "node_id", PARAM_NODE_ID },
+	{ "interval", PARAM_REPORT_INTERVAL },
+	{ "channel", PARAM_RADIO_CHANNEL },
+	{ "power", PARAM_TX_POWER },
+	{ "hang", PARAM_HANG },
+	{ "deadband", PARAM_DEADBAND },
+	{ "heartbeat", PARAM_HEARTBEAT },
+	{ "rx_dropped", PARAM_RX_DROPPED },
+};
+
+#define UPLINK_NUM_PARAMS (sizeof(uplink_params) / sizeof(uplink_params[0]))
+
+static const char *uplink_param_name(uint8_t param)
+{
+	unsigned int i;
+
+	for (i = 0; i < UPLINK_NUM_PARAMS; i++)
+		if (uplink_params[i].param == param)
+			return uplink_params[i].name;
+	return "unknown";
+}
+
+static int uplink_put(uint8_t *out, int n, uint8_t data)
+{
+	if (data == UPLINK_SLIP_END) {
+		out[n++] = UPLINK_SLIP_ESC;
+		out[n++] = UPLINK_SLIP_ESC_END;
+	} else if (data == UPLINK_SLIP_ESC) {
+		out[n++] = UPLINK_SLIP_ESC;
+		out[n++] = UPLINK_SLIP_ESC_ESC;
+	} else {
+		out[n++] = data;
+	}
+	return n;
+}
+
+int uplink_encode_command(const char *line, uint8_t *out)
+{
+	char verb[8], name[16];
+	unsigned long value = 0;
+	uint8_t frame[UPLINK_HEADER_LEN + UPLINK_CMD_LEN];
+	uint16_t crc = UPLINK_CRC16_INIT;
+	unsigned int i;
+	int fields, n = 0;
+
+	fields = sscanf(line, "%7s %15s %lu", verb, name, &value);
+	if (fields < 1)
+		return -1;
+
+	if (strcmp(verb, "prof") == 0 || strcmp(verb, "sched") == 0) {
+		if (fields == 1)
+			value = 0;
+		else if (fields == 2 && strcmp(name, "reset") == 0)
+			value = 1;
+		else
+			return -1;
+		frame[0] = strcmp(verb, "prof") == 0 ?
+		    UPLINK_TYPE_CMD_PROF : UPLINK_TYPE_CMD_SCHED;
+		frame[UPLINK_HEADER_LEN + UPLINK_CMD_PARAM] = 0;
+	} else {
+		if (strcmp(verb, "get") == 0 && fields == 2)
+			frame[0] = UPLINK_TYPE_CMD_GET;
+		else if (strcmp(verb, "set") == 0 && fields == 3 &&
+			 value <= 0xFFFF)
+			frame[0] = UPLINK_TYPE_CMD_SET;
+		else
+			return -1;
+
+		for (i = 0; i < UPLINK_NUM_PARAMS; i++)
+			if (strcmp(uplink_params[i].name, name) == 0)
+				break;
+		if (i == UPLINK_NUM_PARAMS)
+			return -1;
+		frame[UPLINK_HEADER_LEN + UPLINK_CMD_PARAM] =
+		    uplink_params[i].param;
+	}
+
+	frame[1] = 0;		/* timestamp, ignored by the sink */
+	frame[2] = 0;
+	frame[UPLINK_HEADER_LEN + UPLINK_CMD_VALUE] = value & 0xFF;
+	frame[UPLINK_HEADER_LEN + UPLINK_CMD_VALUE + 1] = value >> 8;
+
+	out[n++] = UPLINK_SLIP_END;
+	for (i = 0; i < sizeof(frame); i++) {
+		crc = uplink_crc16_update(crc, frame[i]);
+		n = uplink_put(out, n, frame[i]);
+	}
+	n = uplink_put(out, n, crc & 0xFF);
+	n = uplink_put(out, n, crc >> 8);
+	out[n++] = UPLINK_SLIP_END;
+	return n;
+}
+
+void uplink_print_param(FILE *out, const uint8_t *frame, int length)
+{
+	const uint8_t *payload = frame + UPLINK_HEADER_LEN;
+
+	if (frame[0] != UPLINK_TYPE_PARAM ||
+	    length < UPLINK_HEADER_LEN + UPLINK_PARAM_LEN)
+		return;
+
+	fprintf(out, "param,%s,%u,status,%u\n",
+		uplink_param_name(payload[UPLINK_PARAM_PARAM]),
+		payload[UPLINK_PARAM_VALUE] |
+		(payload[UPLINK_PARAM_VALUE + 1] << 8),
+		payload[UPLINK_PARAM_STATUS]);
+}
+
+/* probe ids of ez430-drivers/inc/prof.h and of the demo main.c */
+static const char *uplink_prof_names[] = {
+	"cc2500_rx_pkt_eop",
+	"adc10_sample_temp",
+	"adc10_scan",
+	"thread_process_msg",
+};
+
+#define UPLINK_NUM_PROF_NAMES \
+	(sizeof(uplink_prof_names) / sizeof(uplink_prof_names[0]))
+
+static unsigned long uplink_get32(const uint8_t *data)
+{
+	return data[0] | (data[1] << 8) | ((unsigned long)data[2] << 16) |
+	    ((unsigned long)data[3] << 24);
+}
+
+void uplink_print_prof(FILE *out, const uint8_t *frame, int length)
+{
+	const uint8_t *payload = frame + UPLINK_HEADER_LEN;
+	unsigned int khz, count;
+	double us_per_cycle;
+
+	if (frame[0] != UPLINK_TYPE_PROF ||
+	    length < UPLINK_HEADER_LEN + UPLINK_PROF_LEN)
+		return;
+
+	khz = payload[UPLINK_PROF_SMCLK_KHZ] |
+	    (payload[UPLINK_PROF_SMCLK_KHZ + 1] << 8);
+	count = payload[UPLINK_PROF_COUNT] | (payload[UPLINK_PROF_COUNT + 1] << 8);
+	if (khz == 0 || count == 0)
+		return;
+	us_per_cycle = 1000.0 / khz;
+
+	if (payload[UPLINK_PROF_ID] < UPLINK_NUM_PROF_NAMES)
+		fprintf(out, "prof,%s", uplink_prof_names[payload[UPLINK_PROF_ID]]);
+	else
+		fprintf(out, "prof,%u", payload[UPLINK_PROF_ID]);
+	fprintf(out, ",count,%u,min,%.1f,max,%.1f,mean,%.1f\n", count,
+		(payload[UPLINK_PROF_MIN] | (payload[UPLINK_PROF_MIN + 1] << 8))
+		* us_per_cycle,
+		(payload[UPLINK_PROF_MAX] | (payload[UPLINK_PROF_MAX + 1] << 8))
+		* us_per_cycle,
+		uplink_get32(payload + UPLINK_PROF_TOTAL) * us_per_cycle / count);
+}
+
+void uplink_print_sched(FILE *out, const uint8_t *frame, int length)
+{
+	const uint8_t *payload = frame + UPLINK_HEADER_LEN;
+	unsigned int khz, runs, i;
+	double us_per_cycle;
+
+	if (frame[0] == UPLINK_TYPE_SCHED_LAT &&
+	    length >= UPLINK_HEADER_LEN + UPLINK_SCHED_LAT_LEN) {
+		fprintf(out, "sched_lat,%u", payload[UPLINK_SCHED_LAT_ID]);
+		for (i = 0; i < UPLINK_SCHED_LAT_BUCKETS; i++)
+			fprintf(out, ",%s%u,%u",
+				i < UPLINK_SCHED_LAT_BUCKETS - 1 ? "<" : ">=",
+				64 << 2 * (i < UPLINK_SCHED_LAT_BUCKETS - 1 ?
+					   i : i - 1),
+				payload[UPLINK_SCHED_LAT_COUNT + 2 * i] |
+				(payload[UPLINK_SCHED_LAT_COUNT + 2 * i + 1] << 8));
+		fprintf(out, "\n");
+		return;
+	}
+
+	if (frame[0] != UPLINK_TYPE_SCHED ||
+	    length < UPLINK_HEADER_LEN + UPLINK_SCHED_LEN)
+		return;
+
+	khz = payload[UPLINK_SCHED_SMCLK_KHZ] |
+	    (payload[UPLINK_SCHED_SMCLK_KHZ + 1] << 8);
+	runs = payload[UPLINK_SCHED_RUNS] | (payload[UPLINK_SCHED_RUNS + 1] << 8);
+	if (khz == 0 || runs == 0)
+		return;
+	us_per_cycle = 1000.0 / khz;
+
+	fprintf(out, "sched,%u", payload[UPLINK_SCHED_ID]);
+	fprintf(out, ",runs,%u,max,%.1f,mean,%.1f,total,%.1f\n", runs,
+		(payload[UPLINK_SCHED_MAX] | (payload[UPLINK_SCHED_MAX + 1] << 8))
+		* us_per_cycle,
+		uplink_get32(payload + UPLINK_SCHED_TOTAL) * us_per_cycle / runs,
+		uplink_get32(payload + UPLINK_SCHED_TOTAL) * us_per_cycle);
+}
+
+/* per node id, the last policy and reading */
+static struct {
+	uint16_t max_silence;	/* seconds, 0 for unknown */
+	time_t last;
+} uplink_nodes[256];
+
+void uplink_print_policy(FILE *out, const uint8_t *frame, int length,
+			 time_t now)
+{
+	const uint8_t *payload = frame + UPLINK_HEADER_LEN;
+	uint8_t id;
+
+	if (frame[0] != UPLINK_TYPE_POLICY ||
+	    length < UPLINK_HEADER_LEN + UPLINK_POLICY_LEN)
+		return;
+
+	id = payload[UPLINK_POLICY_NODE_ID];
+	uplink_nodes[id].max_silence = payload[UPLINK_POLICY_MAX_SILENCE] |
+	    (payload[UPLINK_POLICY_MAX_SILENCE + 1] << 8);
+	/* the policy comes right before a reading */
+	uplink_nodes[id].last = now;
+	fprintf(out, "policy,%d,max_silence,%u\n", id,
+		uplink_nodes[id].max_silence);
+}
+
+void uplink_check_gap(FILE *out, const uint8_t *frame, int length,
+		      time_t now)
+{
+	uint8_t id;
+	uint16_t limit;
+
+	if (frame[0] != UPLINK_TYPE_TEMPERATURE ||
+	    length < UPLINK_HEADER_LEN + UPLINK_TEMPERATURE_LEN)
+		return;
+
+	id = frame[UPLINK_HEADER_LEN + UPLINK_TEMPERATURE_NODE_ID];
+	/* the node timers run from the VLO, calibrated but not exact */
+	limit = uplink_nodes[id].max_silence +
+	    uplink_nodes[id].max_silence / 8 + 2;
+	if (uplink_nodes[id].max_silence != 0 && uplink_nodes[id].last != 0 &&
+	    now - uplink_nodes[id].last > limit)
+		fprintf(out, "gap,%d,%ld\n", id,
+			(long)(now - uplink_nodes[id].last));
+	uplink_nodes[id].last = now;
+}
+
+void uplink_print_csv(FILE *out, const uint8_t *frame, int length)
+{
+	const uint8_t *payload = frame + UPLINK_HEADER_LEN;
+	int16_t temperature;
+
+	switch (frame[0]) {
+	case UPLINK_TYPE_TEMPERATURE:
+		if (length < UPLINK_HEADER_LEN + UPLINK_TEMPERATURE_LEN)
+			break;
+		temperature = (int16_t)(payload[UPLINK_TEMPERATURE_VALUE] |
+					(payload[UPLINK_TEMPERATURE_VALUE + 1] << 8));
+		fprintf(out, "node_id,%d,temperature,%s%d.%d,rssi,%d,help,%d,"
+			"battery,%d.%d\r\n",
+			payload[UPLINK_TEMPERATURE_NODE_ID],
+			temperature < 0 ? "-" : "",
+			(temperature < 0 ? -temperature : temperature) / 10,
+			(temperature < 0 ? -temperature : temperature) % 10,
+			(int8_t)payload[UPLINK_TEMPERATURE_RSSI],
+			payload[UPLINK_TEMPERATURE_HOPS],
+			payload[UPLINK_TEMPERATURE_BATTERY] / 10,
+			payload[UPLINK_TEMPERATURE_BATTERY] % 10);
+		break;
+	default:
+		break;
+	}
+}
@@ -0,0 +1,87 @@
+/*
+ * Host side decoder for the binary uplink of the demo sink
+ * (see board/ez430-applications/demo/src/uplink.h)
+ */
+
+#ifndef UPLINK_DECODER_H
+#define UPLINK_DECODER_H
+
+#include <stdio.h>
+#include <time.h>
+
+#include "uplink.h"
+
+struct uplink_decoder {
+	uint8_t frame[UPLINK_FRAME_MAX];
+	int length;
+	int escaped;
+	int overflow;
+	unsigned long frames;
+	unsigned long errors;
+};
+
+void uplink_decoder_init(struct uplink_decoder *dec);
+
+/*
+ * Feeds one received byte.
+ * Returns the frame length (header and payload, without crc) once a
+ * valid frame is complete, 0 while in the middle of a frame and -1 when
+ * a corrupted frame has been dropped.
+ */
+int uplink_decode_byte(struct uplink_decoder *dec, uint8_t data);
+
+/*
+ * Parses an operator command, "get <param>" or "set <param> <value>"
+ * with <param> one of node_id, interval, channel, power or hang, "prof" or
+ * "prof reset" (dump the profiling probes, then clear them), or "sched"
+ * or "sched reset" (the same for the thread statistics), and SLIP
+ * encodes it into out (at least 2 * UPLINK_FRAME_MAX + 2 bytes).
+ * Returns the encoded length, or -1 if the command is not understood.
+ */
+int uplink_encode_command(const char *line, uint8_t *out);
+
+/*
+ * Prints a decoded UPLINK_TYPE_PARAM frame as
+ * "param,<name>,<value>,status,<status>".
+ */
+void uplink_print_param(FILE *out, const uint8_t *frame, int length);
+
+/*
+ * Prints a decoded UPLINK_TYPE_PROF frame as
+ * "prof,<probe>,count,<n>,min,<us>,max,<us>,mean,<us>".
+ */
+void uplink_print_prof(FILE *out, const uint8_t *frame, int length);
+
+/*
+ * Prints a decoded UPLINK_TYPE_SCHED frame as
+ * "sched,<id>,runs,<n>,max,<us>,mean,<us>,total,<us>" and an
+ * UPLINK_TYPE_SCHED_LAT frame as "sched_lat,<id>,<64,<n>,...",
+ * latency bounds in SMCLK cycles. <id> is the THREAD_<NAME> id of the
+ * firmware task table: ids only count its enabled tasks, which depend
+ * on the build.
+ */
+void uplink_print_sched(FILE *out, const uint8_t *frame, int length);
+
+/*
+ * Prints a decoded UPLINK_TYPE_POLICY frame as
+ * "policy,<node_id>,max_silence,<s>" and remembers the policy of the
+ * node, received at time now.
+ */
+void uplink_print_policy(FILE *out, const uint8_t *frame, int length,
+			 time_t now);
+
+/*
+ * Prints "gap,<node_id>,<s>" if the decoded reading frame, received at
+ * time now, comes longer than the max silence of its node after the
+ * previous one: readings were lost, not held back by the node.
+ */
+void uplink_check_gap(FILE *out, const uint8_t *frame, int length,
+		      time_t now);
+
+/*
+ * Prints a decoded frame as the CSV lines historically printed by the
+ * sink, so that the frontend keeps working unchanged.
+ */
+void uplink_print_csv(FILE *out, const uint8_t *frame, int length);
+
+#endif
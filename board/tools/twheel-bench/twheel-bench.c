@@ -0,0 +1,106 @@
+/**
+ *  \file   twheel-bench.c
+ *  \brief  host benchmark of the timing wheel (ez430-drivers/src/twheel.c)
+ *
+ * Starts n timers with random timeouts, stops every other one, then
+ * ticks the wheel until the others fired, for growing n. The costs per
+ * start, per stop and per fired timer should not depend on n (the cost
+ * per tick grows with the number of timers firing on each tick). Every
+ * timer is also checked to fire exactly on its tick, and only once.
+ **/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "twheel.h"
+
+struct bench_timer {
+	struct twheel_timer t;	/* first, the callback casts back */
+	uint32_t deadline;
+};
+
+static uint32_t now;
+static unsigned long fired, late;
+
+static int bench_cb(struct twheel_timer *t)
+{
+	struct bench_timer *b = (struct bench_timer *)t;
+
+	fired++;
+	if (b->deadline != now)
+		late++;
+	return 0;
+}
+
+static double elapsed_ns(struct timespec *start)
+{
+	struct timespec end;
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	return (end.tv_sec - start->tv_sec) * 1e9 +
+	    (end.tv_nsec - start->tv_nsec);
+}
+
+static int bench(unsigned long n)
+{
+	struct bench_timer *timers = calloc(n, sizeof(*timers));
+	struct timespec start;
+	double start_ns, stop_ns, tick_ns;
+	unsigned long i, ticks = 0;
+	uint16_t delay;
+
+	if (timers == NULL)
+		return -1;
+
+	twheel_init();
+	now = 0;
+	fired = 0;
+	late = 0;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < n; i++) {
+		delay = 1 + rand() % TWHEEL_MAX_TICKS;
+		timers[i].deadline = now + delay;
+		twheel_start(&timers[i].t, delay, bench_cb);
+	}
+	start_ns = elapsed_ns(&start);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 1; i < n; i += 2)
+		twheel_stop(&timers[i].t);
+	stop_ns = elapsed_ns(&start);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	while (twheel_count() > 0) {
+		now++;
+		twheel_tick();
+		ticks++;
+	}
+	tick_ns = elapsed_ns(&start);
+
+	printf("%8lu timers: %5.1f ns/start, %5.1f ns/stop, "
+	       "%5.1f ns/fired, %7.1f ns/tick, %lu late\n",
+	       n, start_ns / n, stop_ns / (n / 2), tick_ns / (n - n / 2),
+	       tick_ns / ticks, late);
+
+	free(timers);
+	return (fired == n - n / 2 && late == 0) ? 0 : -1;
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned long n;
+	int ret = 0;
+
+	printf("wheel: %d levels of %d slots, %lu ticks span\n",
+	       TWHEEL_LEVELS, TWHEEL_SLOTS, TWHEEL_MAX_TICKS);
+
+	srand(1);
+	for (n = 1000; n <= 256000; n *= 4)
+		if (bench(n) != 0)
+			ret = 1;
+
+	return ret;
+}